@@ -6,7 +6,11 @@
 
 /* To compile, the GMP library needs to be already installed.                */
 /* See https://gmplib.org                                                    */
-/* On linux, try:  cc WheelTF.c -lgmp -o WheelTF                             */
+/* On linux, try:                                                            */
+/*   cc WheelTF.c factor_infos.c primality.c stats.c -lgmp -lpthread \      */
+/*      -o WheelTF                                                           */
+/* Build with -DFACTOR_NO_MAIN to link WheelTF() into another program.       */
+/* --stats (or --stats=json) reports the work done, see stats.c.             */
 
 
 /* The maximum integer we attempt to trial factor is hard-coded to approx.   */
@@ -33,24 +37,11 @@
 #include <limits.h>
 #include <gmp.h>
 
-struct factor_info {
-mpz_t           the_factor;
-long            occurrences;
-char            factor_status;
-};
-
-struct factor_infos {
-long                 count;
-struct factor_info*  the_factors;
-};
-
-char quickprimecheck( mpz_t );
-void TFDivideOut( mpz_t, long, char*, mpz_t, struct factor_infos* );
-void WheelTF( mpz_t, struct factor_infos* );
-long ComputeOccurrences( mpz_t, mpz_t );
-void Init_Factor_Infos( struct factor_infos* );
-void AddFactorInfo( struct factor_infos*, mpz_t, long, char );
-void Cleanup_Factor_Infos( struct factor_infos* );
+#include "factor_infos.h"
+#include "WheelTF.h"
+#include "stats.h"
+
+static void TFDivideOut( mpz_t, long, char*, mpz_t, struct factor_infos* );
 
 // Explanation of where the numbers come from.
 
@@ -64,20 +55,27 @@ void Cleanup_Factor_Infos( struct factor_infos* );
 // yields 4,2,4,2,4,6,2,6
 
 // wheel3 and wheel5 are just here for illustration purposes
-const uint8_t wheel3[2] = { 2, 4 };
-const uint8_t wheel5[8] = { 4, 2, 4, 2, 4, 6, 2, 6 };
+//   wheel3[2] = { 2, 4 };
+//   wheel5[8] = { 4, 2, 4, 2, 4, 6, 2, 6 };
+
+// Work done on this thread, for --stats
+__thread struct wheeltf_counts WheelTF_Counts;
 
 // wheel7 is what we actually use
-const uint8_t wheel7[48] = { 2, 4, 2, 4, 6, 2, 6, 4, 2, 4,
-                             6, 6, 2, 6, 4, 2, 6, 4, 6, 8,
-                             4, 2, 4, 2, 4, 8, 6, 4, 6, 2,
-                             4, 6, 2, 6, 6, 4, 2, 4, 6, 2,
-                             6, 4, 2, 4, 2, 10, 2, 10 };
+static const uint8_t wheel7[48] = { 2, 4, 2, 4, 6, 2, 6, 4, 2, 4,
+                                    6, 6, 2, 6, 4, 2, 6, 4, 6, 8,
+                                    4, 2, 4, 2, 4, 8, 6, 4, 6, 2,
+                                    4, 6, 2, 6, 6, 4, 2, 4, 6, 2,
+                                    6, 4, 2, 4, 2, 10, 2, 10 };
 
+#ifndef FACTOR_NO_MAIN
 int main( int argc, char * argv[] ) {
 
+  struct stats stats;
+  Stats_Init( &stats, &argc, argv );
+
   if ( argc != 2 ) {
-    printf( "\nUsage: WheelTF n\n\n" );
+    printf( "\nUsage: WheelTF [--stats[=json]] n\n\n" );
     return 1;
   }
 
@@ -93,84 +91,90 @@ int main( int argc, char * argv[] ) {
   struct factor_infos Factor_Infos;
   Init_Factor_Infos( &Factor_Infos );
 
+  Stats_Phase_Start( &stats, "trial division" );
   WheelTF( n, &Factor_Infos );
+  Stats_Phase_Stop( &stats );
+  Stats_Count( &stats, "candidates tested", WheelTF_Counts.candidates );
+  Stats_Count( &stats, "mpz_divisible_ui_p calls", WheelTF_Counts.divisible_calls );
+  Stats_Count( &stats, "factors divided out", WheelTF_Counts.divide_outs );
+  Stats_Count( &stats, "primality tests", WheelTF_Counts.prime_tests );
 
-  printf("\n");
-  long i = 0;
-  for ( ; i < Factor_Infos.count; i++ ) {
-    if ( i > 0 )
-      printf( ".");
-
-    gmp_printf( "%Zd", Factor_Infos.the_factors[i].the_factor );
-
-    if ( Factor_Infos.the_factors[i].factor_status == 'C' )
-      printf("C");
-
-    if ( Factor_Infos.the_factors[i].occurrences > 1 )
-      printf( "^%ld", Factor_Infos.the_factors[i].occurrences );
-  }
-  printf("\n");
+  Print_Factor_Infos( &Factor_Infos );
+  Stats_Print( &stats, stderr );
+  Stats_Cleanup( &stats );
 
   Cleanup_Factor_Infos( &Factor_Infos );
   mpz_clear( n );
 
   return 0;
 }
-
-// Returns number type.  'C' --> Composite, 'P' --> Prime (very probably), 'N' --> Neither (ie. the number 1)
-char quickprimecheck( mpz_t the_number ) {
-
-  char retval = 'C';
-  if ( mpz_cmp_ui( the_number, 1 ) == 0 ) {
-    retval = 'N';
-    return retval;
-  }
-
-  int factor_type = mpz_probab_prime_p( the_number, 30 );
-  if ( factor_type != 0 )
-    retval = 'P';
-
-  return retval;
-}
-
+#endif
 
 // divide out denominator from running_N
-void TFDivideOut( mpz_t running_N, long ldenominator, char* running_N_status, mpz_t square_root, struct factor_infos* Factor_Infos ) {
+static void TFDivideOut( mpz_t running_N, long ldenominator, char* running_N_status, mpz_t square_root, struct factor_infos* Factor_Infos ) {
 
-  mpz_t denominator;
-  mpz_init_set_ui( denominator, ldenominator );
+  long occurrences = 0;
+  while ( mpz_divisible_ui_p( running_N, ldenominator ) ) {
+    mpz_divexact_ui( running_N, running_N, ldenominator );
+    occurrences++;
+  }
 
-  long occurrences = ComputeOccurrences( running_N, denominator );
+  WheelTF_Counts.divide_outs++;
+  WheelTF_Counts.divisible_calls += occurrences + 1;
 
-  long i = 0;
-  for ( i = occurrences; i > 0; i-- )
-    mpz_divexact_ui( running_N, running_N, ldenominator );
+  // Every prime below ldenominator has been divided out already, so anything
+  // left below ldenominator^2 must be prime.  No need to test it.
+  if ( mpz_cmp_ui( running_N, 1 ) > 0 && ldenominator < 4294967296l
+       && mpz_cmp_ui( running_N, (unsigned long) ldenominator * ldenominator ) < 0 )
+    *running_N_status = 'P';
+  else {
+    *running_N_status = quickprimecheck( running_N );
+    WheelTF_Counts.prime_tests++;
+  }
 
-  *running_N_status = quickprimecheck( running_N );
   if ( *running_N_status == 'N' )
     mpz_set_ui( square_root, 1 );
   else
     mpz_sqrt( square_root, running_N );
 
-  AddFactorInfo( Factor_Infos, denominator, occurrences, 'P' );
-
-  mpz_clear( denominator );
+  AddFactorInfoUI( Factor_Infos, ldenominator, occurrences, 'P' );
 }
 
 // Compute the prime factorization of a general number
 void WheelTF( mpz_t the_number, struct factor_infos* Factor_Infos ) {
+  WheelTFLimit( the_number, 4000000000ul, Factor_Infos );
+}
+
+// Trial factor with primes up to tf_limit only.  Whatever is left over is
+// added as the last entry, with status 'P' or 'C'.
+void WheelTFLimit( mpz_t the_number, unsigned long tf_limit, struct factor_infos* Factor_Infos ) {
+  if ( Factor_Infos == NULL )
+    return;
+
+  mpz_t running_N;
+  mpz_init( running_N );
+  mpz_t square_root;
+  mpz_init( square_root );
+
+  WheelTF_Scratch( the_number, tf_limit, running_N, square_root, Factor_Infos );
+
+  mpz_clear( square_root );
+  mpz_clear( running_N );
+}
+
+// WheelTFLimit() with the caller's temporaries, so repeated calls need not
+// allocate.
+void WheelTF_Scratch( mpz_t the_number, unsigned long tf_limit, mpz_t running_N, mpz_t square_root, struct factor_infos* Factor_Infos ) {
   if ( Factor_Infos == NULL )
     return;
 
   // Wheel Factorization. see eg. http://programmingpraxis.com/2009/05/08/wheel-factorization/
   // Use a 2,3,5,7 wheel (or 'wheel7' for short)
 
-  mpz_t running_N;
-  mpz_init_set( running_N, the_number );
+  mpz_set( running_N, the_number );
   char running_N_status = quickprimecheck( running_N );
+  WheelTF_Counts.prime_tests++;
 
-  mpz_t square_root;
-  mpz_init( square_root );
   mpz_sqrt( square_root, running_N );
 
   // This wheel only starts to be applied at number 11, so 2, 3, 5, and 7
@@ -188,15 +192,16 @@ void WheelTF( mpz_t the_number, struct factor_infos* Factor_Infos ) {
     TFDivideOut( running_N, 7, &running_N_status, square_root, Factor_Infos );
 
   // for speed reasons, we will use an unsigned long as the trial factor and as the tf upper limit.
-  unsigned long tf_upperlimit =  4000000000ul;
+  unsigned long tf_upperlimit = tf_limit;
 
   if ( mpz_cmp_ui( square_root, tf_upperlimit ) < 0 )
     tf_upperlimit = mpz_get_ui( square_root );
 
   uint8_t i = 0;
   unsigned long tf = 11;
+  uint64_t candidates = 4;   // 2, 3, 5 and 7
 
-  for ( i = 0; tf <= tf_upperlimit; tf += wheel7[i], i = ( i == 47 ? 0 : i + 1 ) ) {
+  for ( i = 0; tf <= tf_upperlimit; tf += wheel7[i], i = ( i == 47 ? 0 : i + 1 ), candidates++ ) {
       if ( mpz_divisible_ui_p( running_N, tf ) != 0 ) {
         TFDivideOut( running_N, tf, &running_N_status, square_root, Factor_Infos );
         if ( running_N_status != 'C' )
@@ -210,78 +215,10 @@ void WheelTF( mpz_t the_number, struct factor_infos* Factor_Infos ) {
   if ( mpz_cmp_ui( running_N, 1 ) != 0 )
     AddFactorInfo( Factor_Infos, running_N, 1, running_N_status );
 
-  mpz_clear( square_root );
-  mpz_clear( running_N );
-}
-
-// Compute the number of times denominator divides evenly into numerator
-long ComputeOccurrences( mpz_t numerator, mpz_t denominator ) {
-
-  // not handled values
-  if ( mpz_cmp_ui( denominator, 1 ) <= 0 )
-    return -1;
-
-  long occurrences = 0;
-
-  mpz_t quotient;
-  mpz_init_set( quotient, numerator );
-
-  while ( mpz_divisible_p( quotient, denominator ) ) {
-    mpz_divexact( quotient, quotient, denominator );
-    occurrences++;
-  }
-
-  mpz_clear( quotient );
-
-  return occurrences;
-}
-
-// Initialize factor_infos
-void Init_Factor_Infos( struct factor_infos* Factor_Infos ) {
-  if ( Factor_Infos == NULL )
-    return;
-  Factor_Infos->count = 0;
-  Factor_Infos->the_factors = NULL;
-}
-
-// Add a factor to factor_infos structure
-void AddFactorInfo( struct factor_infos* Factor_Infos, mpz_t the_factor, long occurrences, char factor_status ) {
-
-  long index = 0;
-
-  // allocate memory
-  if ( Factor_Infos->count == 0 ) {
-    Factor_Infos->count = 1;
-    Factor_Infos->the_factors = (struct factor_info*) calloc( 1, sizeof(struct factor_info) );
-  }
-  else {
-    Factor_Infos->count++;
-    Factor_Infos->the_factors = (struct factor_info*) realloc( Factor_Infos->the_factors, sizeof(struct factor_info) * Factor_Infos->count );
-    index = Factor_Infos->count - 1;
-    memset( &Factor_Infos->the_factors[index], 0, sizeof(struct factor_info) );
-  }
-
-  mpz_init( Factor_Infos->the_factors[index].the_factor );
-  mpz_set( Factor_Infos->the_factors[index].the_factor, the_factor );
-  Factor_Infos->the_factors[index].occurrences    = occurrences;
-  Factor_Infos->the_factors[index].factor_status  = factor_status;
+  // the hit that broke out of the loop was not counted by the increment
+  if ( tf <= tf_upperlimit )
+    candidates++;
+  WheelTF_Counts.candidates += candidates;
+  WheelTF_Counts.divisible_calls += candidates;
 }
 
-// Free the memory allocated
-void Cleanup_Factor_Infos( struct factor_infos* Factor_Infos ) {
-  if ( Factor_Infos == NULL )
-    return;
-
-  long i;
-  for ( i = 0; i < Factor_Infos->count; i++ )
-    mpz_clear( Factor_Infos->the_factors[i].the_factor );
-
-  if ( Factor_Infos->the_factors != NULL ) {
-    free( Factor_Infos->the_factors );
-    Factor_Infos->the_factors = NULL;
-  }
-  Factor_Infos->count = 0;
-}
-
-
-
@@ -0,0 +1,26 @@
+/* Public Domain.  See the LICENSE file.                                     */
+
+/* Wheel trial division, see WheelTF.c                                       */
+
+#ifndef WHEELTF_H
+#define WHEELTF_H
+
+#include <stdint.h>
+#include <gmp.h>
+#include "factor_infos.h"
+
+// Work done by WheelTF_Scratch() on this thread, for --stats
+struct wheeltf_counts {
+uint64_t        candidates;         // trial divisors tried
+uint64_t        divisible_calls;    // mpz_divisible_ui_p() calls
+uint64_t        divide_outs;        // TFDivideOut() calls
+uint64_t        prime_tests;        // quickprimecheck() calls
+};
+
+extern __thread struct wheeltf_counts WheelTF_Counts;
+
+void WheelTF( mpz_t, struct factor_infos* );
+void WheelTFLimit( mpz_t, unsigned long, struct factor_infos* );
+void WheelTF_Scratch( mpz_t, unsigned long, mpz_t, mpz_t, struct factor_infos* );
+
+#endif
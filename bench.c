@@ -0,0 +1,343 @@
+/* Public Domain.  See the LICENSE file.                                     */
+
+/* Benchmark harness for the programs in this repository.  Every workload    */
+/* below is a fixed command line, run as a child process (fork/execv, with   */
+/* its output sent to /dev/null) a number of times.  For each one the wall   */
+/* time (min, median, p90, max), the throughput at the median and the peak   */
+/* resident set size (from wait4's rusage) are printed and written as JSON.  */
+/*                                                                           */
+/* Given a baseline (an earlier JSON file from this program), any workload   */
+/* whose median got slower by more than the tolerance is flagged and the     */
+/* exit status is 2.                                                         */
+
+/* No dependencies.  Normally built and run with "make bench", see Makefile. */
+/* On linux, try:  cc -O2 bench.c -o benchmark                               */
+/*                 ./benchmark -o bench.json -b bench_baseline.json          */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#define BENCH_MAX_ARGS     4
+#define BENCH_MAX_RUNS     100
+#define BENCH_MIN_DELTA    0.005    // secs.  Smaller slowdowns are noise
+
+struct workload {
+const char*     name;
+const char*     args[BENCH_MAX_ARGS];   // program first, NULL terminated
+double          units;                  // work done by one run
+const char*     unit_name;
+int             runs;                   // default repetitions
+};
+
+struct result {
+double          min, median, p90, max;
+long            peak_rss_kib;
+int             runs;
+int             failed;
+};
+
+// Each factoring tool gets two semiprimes at each size, as the work follows
+// the factors, not n.  WheelTF and rho take time in the smaller factor, so
+// the nearly equal semiprimes from the comments of WheelTF.c are their worst
+// case and the _unbalanced rows (a cube root sized prime times the rest) their
+// best.  rho also gets larger balanced n, so it runs for more than the start
+// up.  Fermat takes time in the gap between the factors:  the _equal rows
+// split at once, and the _gap rows are picked to take 2 x 10^6 steps.
+const struct workload workloads[] = {
+  { "WheelTF_1e6",              { "WheelTF", "1022117" },                         1,    "numbers", 5 },
+  { "WheelTF_1e8",              { "WheelTF", "100160063" },                       1,    "numbers", 5 },
+  { "WheelTF_1e10",             { "WheelTF", "10002200057" },                     1,    "numbers", 5 },
+  { "WheelTF_1e12",             { "WheelTF", "1000036000099" },                   1,    "numbers", 5 },
+  { "WheelTF_1e14",             { "WheelTF", "100000980001501" },                 1,    "numbers", 5 },
+  { "WheelTF_1e16",             { "WheelTF", "10000004400000259" },               1,    "numbers", 5 },
+  { "WheelTF_1e18",             { "WheelTF", "1000000016000000063" },             1,    "numbers", 3 },
+  { "WheelTF_1e10_unbalanced",  { "WheelTF", "10000077203" },                     1,    "numbers", 5 },
+  { "WheelTF_1e12_unbalanced",  { "WheelTF", "1000000000343" },                   1,    "numbers", 5 },
+  { "WheelTF_1e14_unbalanced",  { "WheelTF", "100000000626671" },                 1,    "numbers", 5 },
+  { "WheelTF_1e16_unbalanced",  { "WheelTF", "10000000000992481" },               1,    "numbers", 5 },
+  { "WheelTF_1e18_unbalanced",  { "WheelTF", "1000000000018000081" },             1,    "numbers", 5 },
+  { "eratosthenes_1e8",         { "eratosthenes", "100000000" },                  1e8,  "integers", 5 },
+  { "eratosthenes_1e9",         { "eratosthenes", "1000000000" },                 1e9,  "integers", 3 },
+  { "eratosthenes_1e10",        { "eratosthenes", "10000000000" },                1e10, "integers", 1 },
+  { "prime_range2_1e12",        { "prime_range2", "1000000000000", "1000010000000" },  1e7,  "integers", 5 },
+  { "prime_range2_1e18",        { "prime_range2", "999999999999000000", "1000000000000000000" }, 1e6, "integers", 3 },
+  { "factor_range_1e12",        { "factor_range", "1000000000000", "1000001000000" },  1e6,  "integers", 5 },
+  { "rho_1e12",                 { "rho", "1000036000099" },                       1,    "numbers", 5 },
+  { "rho_1e14",                 { "rho", "100000980001501" },                     1,    "numbers", 5 },
+  { "rho_1e16",                 { "rho", "10000004400000259" },                   1,    "numbers", 5 },
+  { "rho_1e18",                 { "rho", "1000000016000000063" },                 1,    "numbers", 5 },
+  { "rho_1e20",                 { "rho", "100000000520000000627" },               1,    "numbers", 5 },
+  { "rho_1e22",                 { "rho", "10000000007600000001083" },             1,    "numbers", 3 },
+  { "rho_1e12_unbalanced",      { "rho", "1000000000343" },                       1,    "numbers", 5 },
+  { "rho_1e14_unbalanced",      { "rho", "100000000626671" },                     1,    "numbers", 5 },
+  { "rho_1e16_unbalanced",      { "rho", "10000000000992481" },                   1,    "numbers", 5 },
+  { "rho_1e18_unbalanced",      { "rho", "1000000000018000081" },                 1,    "numbers", 5 },
+  { "fermat_1e10_gap",          { "fermat", "10000004519" },                      1,    "numbers", 5 },
+  { "fermat_1e12_gap",          { "fermat", "1000000651721" },                    1,    "numbers", 5 },
+  { "fermat_1e14_gap",          { "fermat", "100000022300137" },                  1,    "numbers", 5 },
+  { "fermat_1e16_gap",          { "fermat", "10000001150336521" },                1,    "numbers", 5 },
+  { "fermat_1e18_gap",          { "fermat", "1000000007034334409" },              1,    "numbers", 5 },
+  { "fermat_1e10_equal",        { "fermat", "10002200057" },                      1,    "numbers", 5 },
+  { "fermat_1e12_equal",        { "fermat", "1000036000099" },                    1,    "numbers", 5 },
+  { "fermat_1e16_equal",        { "fermat", "10000004400000259" },                1,    "numbers", 5 },
+  { "fermat_1e18_equal",        { "fermat", "1000000016000000063" },              1,    "numbers", 5 },
+};
+
+#define WORKLOAD_COUNT ((int) (sizeof(workloads) / sizeof(workloads[0])))
+
+int Run_Workload( const char*, const struct workload*, int, struct result* );
+int Run_Once( const char*, const struct workload*, double*, long* );
+int Compare_Doubles( const void*, const void* );
+double Percentile( double*, int, double );
+int Baseline_Median( const char*, const char*, double* );
+char* Read_File( const char* );
+void Write_JSON( FILE*, const struct result* );
+
+int main( int argc, char * argv[] ) {
+
+  const char* bindir = ".";
+  const char* filter = NULL;
+  const char* out_path = NULL;
+  const char* baseline_path = NULL;
+  double tolerance = 10.0;
+  int runs = 0;
+
+  int argi = 1;
+  for ( ; argi < argc; argi++ ) {
+    if ( argi + 1 >= argc )
+      break;
+    if ( !strcmp( argv[argi], "-d" ) )
+      bindir = argv[++argi];
+    else if ( !strcmp( argv[argi], "-f" ) )
+      filter = argv[++argi];
+    else if ( !strcmp( argv[argi], "-o" ) )
+      out_path = argv[++argi];
+    else if ( !strcmp( argv[argi], "-b" ) )
+      baseline_path = argv[++argi];
+    else if ( !strcmp( argv[argi], "-t" ) )
+      tolerance = atof( argv[++argi] );
+    else if ( !strcmp( argv[argi], "-r" ) )
+      runs = atoi( argv[++argi] );
+    else
+      break;
+  }
+
+  if ( argi != argc || runs < 0 || runs > BENCH_MAX_RUNS ) {
+    printf( "\nUsage: benchmark [-d bindir] [-f filter] [-r runs] [-o out.json] [-b baseline.json] [-t tolerance%%]\n\n" );
+    printf( "  -f   only workloads whose name contains filter\n" );
+    printf( "  -r   runs per workload (default depends on the workload, max %d)\n", BENCH_MAX_RUNS );
+    printf( "  -t   slowdown of the median, in percent, flagged as a regression (default 10)\n\n" );
+    return 1;
+  }
+
+  char* baseline = NULL;
+  if ( baseline_path != NULL ) {
+    baseline = Read_File( baseline_path );
+    if ( baseline == NULL )
+      printf( "\nNo baseline in %s, nothing to compare against.\n", baseline_path );
+  }
+
+  FILE* out = NULL;
+  if ( out_path != NULL ) {
+    out = fopen( out_path, "w" );
+    if ( out == NULL ) {
+      fprintf( stderr, "Error: Cannot write %s. Aborting.\n\n", out_path );
+      free( baseline );
+      return 1;
+    }
+    fprintf( out, "{\n  \"workloads\": [" );
+  }
+
+  printf( "\n%-24s %5s %11s %11s %11s %20s %12s  %s\n", "workload", "runs", "min (s)", "median (s)",
+          "p90 (s)", "throughput", "peak RSS", baseline != NULL ? "vs baseline" : "" );
+
+  int regressions = 0;
+  int failures = 0;
+  int written = 0;
+  int w;
+  for ( w = 0; w < WORKLOAD_COUNT; w++ ) {
+    const struct workload* work = &workloads[w];
+    if ( filter != NULL && strstr( work->name, filter ) == NULL )
+      continue;
+
+    struct result res;
+    Run_Workload( bindir, work, runs > 0 ? runs : work->runs, &res );
+
+    if ( res.failed ) {
+      printf( "%-24s  failed\n", work->name );
+      failures++;
+      continue;
+    }
+
+    char throughput[32];
+    snprintf( throughput, sizeof(throughput), "%.4g %s/s", res.median > 0 ? work->units / res.median : 0.0,
+              work->unit_name );
+
+    printf( "%-24s %5d %11.6f %11.6f %11.6f %20s %8ld KiB", work->name, res.runs, res.min, res.median,
+            res.p90, throughput, res.peak_rss_kib );
+
+    double base_median;
+    if ( baseline != NULL && Baseline_Median( baseline, work->name, &base_median ) ) {
+      double change = base_median > 0 ? 100.0 * (res.median - base_median) / base_median : 0.0;
+      int regressed = change > tolerance && res.median - base_median > BENCH_MIN_DELTA;
+      printf( "  %+7.1f%%%s", change, regressed ? "  REGRESSION" : "" );
+      regressions += regressed;
+    }
+    printf( "\n" );
+
+    if ( out != NULL ) {
+      fprintf( out, "%s\n    { \"name\": \"%s\", ", written++ ? "," : "", work->name );
+      fprintf( out, "\"units\": %.0f, \"unit_name\": \"%s\", ", work->units, work->unit_name );
+      fprintf( out, "\"throughput_per_sec\": %.6g, ", res.median > 0 ? work->units / res.median : 0.0 );
+      Write_JSON( out, &res );
+      fprintf( out, " }" );
+    }
+  }
+
+  if ( out != NULL ) {
+    fprintf( out, "\n  ]\n}\n" );
+    fclose( out );
+  }
+
+  printf( "\n" );
+  if ( regressions > 0 )
+    printf( "%d regression%s over %.1f%%.\n\n", regressions, regressions == 1 ? "" : "s", tolerance );
+
+  free( baseline );
+
+  if ( failures > 0 )
+    return 1;
+  return regressions > 0 ? 2 : 0;
+}
+
+// Run work the given number of times and summarize.  Returns 0 if any run
+// failed.
+int Run_Workload( const char* bindir, const struct workload* work, int runs, struct result* res ) {
+  double times[BENCH_MAX_RUNS];
+
+  memset( res, 0, sizeof(struct result) );
+  res->runs = runs;
+
+  int i;
+  for ( i = 0; i < runs; i++ ) {
+    long rss_kib = 0;
+    if ( !Run_Once( bindir, work, &times[i], &rss_kib ) ) {
+      res->failed = 1;
+      return 0;
+    }
+    if ( rss_kib > res->peak_rss_kib )
+      res->peak_rss_kib = rss_kib;
+  }
+
+  qsort( times, runs, sizeof(double), Compare_Doubles );
+  res->min    = times[0];
+  res->median = Percentile( times, runs, 50.0 );
+  res->p90    = Percentile( times, runs, 90.0 );
+  res->max    = times[runs - 1];
+
+  return 1;
+}
+
+// One run of work.  Returns 1 with the wall time and peak RSS if the program
+// exited with status 0.
+int Run_Once( const char* bindir, const struct workload* work, double* secs, long* rss_kib ) {
+  char path[4096];
+  snprintf( path, sizeof(path), "%s/%s", bindir, work->args[0] );
+
+  struct timespec time_t0, time_t1;
+  clock_gettime( CLOCK_MONOTONIC, &time_t0 );
+
+  pid_t pid = fork();
+  if ( pid < 0 )
+    return 0;
+
+  if ( pid == 0 ) {
+    int devnull = open( "/dev/null", O_WRONLY );
+    if ( devnull >= 0 ) {
+      dup2( devnull, STDOUT_FILENO );
+      close( devnull );
+    }
+    execv( path, (char * const *) work->args );
+    fprintf( stderr, "Error: Cannot run %s.\n", path );
+    _exit( 127 );
+  }
+
+  int status = 0;
+  struct rusage usage;
+  if ( wait4( pid, &status, 0, &usage ) != pid )
+    return 0;
+
+  clock_gettime( CLOCK_MONOTONIC, &time_t1 );
+
+  *secs = (time_t1.tv_sec - time_t0.tv_sec) + (time_t1.tv_nsec - time_t0.tv_nsec) / 1e9;
+  *rss_kib = usage.ru_maxrss;
+
+  return WIFEXITED( status ) && WEXITSTATUS( status ) == 0;
+}
+
+int Compare_Doubles( const void* a, const void* b ) {
+  double x = *(const double*) a, y = *(const double*) b;
+  return x < y ? -1 : x > y;
+}
+
+// Nearest rank percentile of the sorted values, p in 0 .. 100
+double Percentile( double* sorted, int count, double p ) {
+  int rank = (int) ((p / 100.0) * count + 0.999999);
+  if ( rank < 1 )
+    rank = 1;
+  if ( rank > count )
+    rank = count;
+  return sorted[rank - 1];
+}
+
+// Find the median of workload name in the JSON text written by this program.
+// Returns 1 if found.
+int Baseline_Median( const char* json, const char* name, double* median ) {
+  char key[256];
+  snprintf( key, sizeof(key), "\"name\": \"%s\"", name );
+
+  const char* entry = strstr( json, key );
+  if ( entry == NULL )
+    return 0;
+
+  const char* end = strchr( entry, '}' );
+  const char* field = strstr( entry, "\"median_secs\":" );
+  if ( field == NULL || (end != NULL && field > end) )
+    return 0;
+
+  return sscanf( field, "\"median_secs\": %lf", median ) == 1;
+}
+
+// Whole file as a string, or NULL
+char* Read_File( const char* path ) {
+  FILE* f = fopen( path, "r" );
+  if ( f == NULL )
+    return NULL;
+
+  fseek( f, 0, SEEK_END );
+  long size = ftell( f );
+  fseek( f, 0, SEEK_SET );
+
+  char* text = (char*) malloc( size + 1 );
+  if ( text != NULL ) {
+    size_t got = fread( text, 1, size, f );
+    text[got] = '\0';
+  }
+  fclose( f );
+
+  return text;
+}
+
+void Write_JSON( FILE* out, const struct result* res ) {
+  fprintf( out, "\"runs\": %d, \"min_secs\": %.9f, \"median_secs\": %.9f, \"p90_secs\": %.9f, \"max_secs\": %.9f, \"peak_rss_kib\": %ld",
+           res->runs, res->min, res->median, res->p90, res->max, res->peak_rss_kib );
+}
@@ -0,0 +1,218 @@
+/* Public Domain.  See the LICENSE file.                                     */
+
+/* Large zeroed allocations (eg. the bitmap of eratosthenes.c) placed on     */
+/* huge pages, so a sieve crossing off at a large stride misses the TLB a    */
+/* lot less often, and spread over NUMA nodes as asked.                      */
+/*                                                                           */
+/* Pages, in order of preference with BIG_PAGES_AUTO or BIG_PAGES_HUGETLB:   */
+/*   hugetlb   mmap with MAP_HUGETLB.  Needs pages reserved by the admin,    */
+/*             eg. echo 6000 > /proc/sys/vm/nr_hugepages                     */
+/*   THP       a 2 MiB aligned anonymous mmap with madvise(MADV_HUGEPAGE).   */
+/*             Needs transparent_hugepage set to "madvise" or "always".      */
+/*             Reported only if /proc/self/smaps shows the kernel gave some  */
+/*             huge pages, as madvise succeeds even when it will not         */
+/*   small     plain 4 KiB pages                                             */
+/*                                                                           */
+/* NUMA placement is set with the mbind system call before any page is       */
+/* touched (no libnuma needed):  interleaved over the online nodes, or local */
+/* to the node that first touches each page.  Every page is then touched     */
+/* once here, so the page faults are paid for at allocation time and not in  */
+/* the middle of the sieve, and the bitmap is placed where the policy says.  */
+/* Big_Describe says so when a policy was asked for but could not be set.    */
+
+/* No dependencies.  Linked into the programs, eg.                           */
+/*   cc -O2 eratosthenes.c stats.c big_alloc.c -o eratosthenes               */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "big_alloc.h"
+
+// from <numaif.h>, which is part of libnuma and not always installed
+#define BIG_MPOL_INTERLEAVE  3
+#define BIG_MPOL_LOCAL       4
+#define BIG_MAX_NODES        1024
+
+static int Online_Nodes( unsigned long*, int );
+static void* Map_Aligned( size_t, size_t* );
+static void Touch_Pages( char*, size_t, size_t );
+static int THP_Enabled( void );
+static size_t THP_Bytes( void* );
+
+// Allocate size zeroed bytes.  Returns 0 if out of memory.
+int Big_Alloc( struct big_block* block, size_t size, enum big_pages pages, enum big_numa numa ) {
+  memset( block, 0, sizeof(struct big_block) );
+  block->size = size;
+  block->numa = numa;
+
+  // not worth it below one huge page
+  if ( size < BIG_HUGE_PAGE && pages == BIG_PAGES_AUTO )
+    pages = BIG_PAGES_SMALL;
+
+  size_t rounded = (size + BIG_HUGE_PAGE - 1) / BIG_HUGE_PAGE * BIG_HUGE_PAGE;
+
+#ifdef MAP_HUGETLB
+  if ( pages == BIG_PAGES_AUTO || pages == BIG_PAGES_HUGETLB ) {
+    void* map = mmap( NULL, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0 );
+    if ( map != MAP_FAILED ) {
+      block->map = block->ptr = map;
+      block->map_size = rounded;
+      block->pages = BIG_PAGES_HUGETLB;
+    }
+  }
+#endif
+
+#ifdef MADV_HUGEPAGE
+  if ( block->ptr == NULL && pages != BIG_PAGES_SMALL && THP_Enabled() ) {
+    void* map = Map_Aligned( rounded, &block->map_size );
+    if ( map != NULL ) {
+      block->map = map;
+      block->ptr = (void*) (((uintptr_t) map + BIG_HUGE_PAGE - 1) & ~((uintptr_t) BIG_HUGE_PAGE - 1));
+      block->pages = madvise( block->ptr, rounded, MADV_HUGEPAGE ) == 0 ? BIG_PAGES_THP : BIG_PAGES_SMALL;
+    }
+  }
+#endif
+
+  if ( block->ptr == NULL ) {
+    if ( size >= BIG_HUGE_PAGE || numa != BIG_NUMA_DEFAULT ) {
+      // mmap'ed, rather than calloc'ed, so mbind can place it
+      void* map = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+      if ( map != MAP_FAILED ) {
+        block->map = block->ptr = map;
+        block->map_size = size;
+      }
+    }
+    else
+      block->ptr = calloc( size, 1 );
+    block->pages = BIG_PAGES_SMALL;
+    if ( block->ptr == NULL )
+      return 0;
+  }
+
+  if ( block->map != NULL && numa != BIG_NUMA_DEFAULT ) {
+    unsigned long nodemask[BIG_MAX_NODES / (8 * sizeof(unsigned long))];
+    int nodes = Online_Nodes( nodemask, BIG_MAX_NODES );
+    int mode = numa == BIG_NUMA_INTERLEAVE ? BIG_MPOL_INTERLEAVE : BIG_MPOL_LOCAL;
+    size_t length = block->map_size - ((char*) block->ptr - (char*) block->map);
+    if ( nodes > 0 && syscall( SYS_mbind, block->ptr, length, mode, mode == BIG_MPOL_LOCAL ? NULL : nodemask,
+                               mode == BIG_MPOL_LOCAL ? 0 : BIG_MAX_NODES + 1, 0 ) == 0 )
+      block->nodes = nodes;
+  }
+
+  if ( block->map != NULL )
+    Touch_Pages( (char*) block->ptr, size, (size_t) sysconf( _SC_PAGESIZE ) );
+
+  // only now are the pages there to look at
+  if ( block->pages == BIG_PAGES_THP && THP_Bytes( block->ptr ) == 0 )
+    block->pages = BIG_PAGES_SMALL;
+
+  return 1;
+}
+
+void Big_Free( struct big_block* block ) {
+  if ( block->map != NULL )
+    munmap( block->map, block->map_size );
+  else
+    free( block->ptr );
+  memset( block, 0, sizeof(struct big_block) );
+}
+
+// eg. "12500000000 bytes on 2 MiB pages (THP), interleaved, 2 NUMA nodes"
+// or "125000000 bytes on 4 KiB pages, NUMA policy not applied"
+void Big_Describe( struct big_block* block, char* text, size_t text_size ) {
+  const char* pages[4] = { "", "2 MiB pages (hugetlb)", "2 MiB pages (THP)", "4 KiB pages" };
+  int used = snprintf( text, text_size, "%zu bytes on %s", block->size, pages[block->pages] );
+  if ( block->nodes > 0 && used > 0 && (size_t) used < text_size )
+    snprintf( text + used, text_size - used, ", %s, %d NUMA node%s",
+              block->numa == BIG_NUMA_INTERLEAVE ? "interleaved" : "local to the first touch",
+              block->nodes, block->nodes == 1 ? "" : "s" );
+  else if ( block->numa != BIG_NUMA_DEFAULT && used > 0 && (size_t) used < text_size )
+    snprintf( text + used, text_size - used, ", NUMA policy not applied" );
+}
+
+// Set a bit per online node, from eg. "0-1,4" in sysfs.  Returns the count.
+static int Online_Nodes( unsigned long* nodemask, int max_nodes ) {
+  memset( nodemask, 0, max_nodes / 8 );
+
+  FILE* f = fopen( "/sys/devices/system/node/online", "r" );
+  if ( f == NULL )
+    return 0;
+  char line[4096];
+  int ok = fgets( line, sizeof(line), f ) != NULL;
+  fclose( f );
+  if ( !ok )
+    return 0;
+
+  int count = 0;
+  char* s = line;
+  while ( *s >= '0' && *s <= '9' ) {
+    long first = strtol( s, &s, 10 );
+    long last = first;
+    if ( *s == '-' )
+      last = strtol( s + 1, &s, 10 );
+    long node;
+    for ( node = first; node <= last && node < max_nodes; node++ ) {
+      nodemask[node / (8 * sizeof(unsigned long))] |= 1ul << (node % (8 * sizeof(unsigned long)));
+      count++;
+    }
+    if ( *s == ',' )
+      s++;
+  }
+  return count;
+}
+
+// An anonymous mapping with room for size bytes from a 2 MiB boundary
+static void* Map_Aligned( size_t size, size_t* map_size ) {
+  *map_size = size + BIG_HUGE_PAGE;
+  void* map = mmap( NULL, *map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+  return map == MAP_FAILED ? NULL : map;
+}
+
+// Fault every page in now.  The memory is already zero.  A huge page takes
+// one fault, and the other writes to it are just writes, so this also
+// covers THP falling back to small pages.
+static void Touch_Pages( char* p, size_t size, size_t page ) {
+  size_t offset;
+  for ( offset = 0; offset < size; offset += page )
+    ((volatile char*) p)[offset] = 0;
+}
+
+// The mode in /sys/kernel/mm/transparent_hugepage/enabled is the one in [],
+// eg. "always [madvise] never".  0 if it is never, or there is no THP.
+static int THP_Enabled( void ) {
+  FILE* f = fopen( "/sys/kernel/mm/transparent_hugepage/enabled", "r" );
+  if ( f == NULL )
+    return 0;
+  char line[256];
+  int ok = fgets( line, sizeof(line), f ) != NULL;
+  fclose( f );
+  return ok && strstr( line, "[never]" ) == NULL;
+}
+
+// AnonHugePages of the mapping holding p, from /proc/self/smaps
+static size_t THP_Bytes( void* p ) {
+  FILE* f = fopen( "/proc/self/smaps", "r" );
+  if ( f == NULL )
+    return 0;
+
+  char line[4096];
+  int inside = 0;
+  size_t kib = 0;
+  while ( fgets( line, sizeof(line), f ) != NULL ) {
+    unsigned long first, last;
+    // a mapping starts with its address range, eg. "7f2a00000000-7f2a08000000 rw-p ..."
+    if ( sscanf( line, "%lx-%lx", &first, &last ) == 2 )
+      inside = (uintptr_t) p >= first && (uintptr_t) p < last;
+    else if ( inside && sscanf( line, "AnonHugePages: %zu kB", &kib ) == 1 )
+      break;
+  }
+  fclose( f );
+
+  return kib * 1024;
+}
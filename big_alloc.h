@@ -0,0 +1,29 @@
+/* Public Domain.  See the LICENSE file.                                     */
+
+/* Large zeroed allocations on huge pages, see big_alloc.c                   */
+
+#ifndef BIG_ALLOC_H
+#define BIG_ALLOC_H
+
+#include <stddef.h>
+
+#define BIG_HUGE_PAGE  (2 * 1024 * 1024)
+
+enum big_pages { BIG_PAGES_AUTO, BIG_PAGES_HUGETLB, BIG_PAGES_THP, BIG_PAGES_SMALL };
+enum big_numa  { BIG_NUMA_DEFAULT, BIG_NUMA_INTERLEAVE, BIG_NUMA_LOCAL };
+
+struct big_block {
+void*           ptr;
+size_t          size;       // as asked for
+void*           map;        // what to munmap, NULL if malloc'ed
+size_t          map_size;
+enum big_pages  pages;      // what was actually used
+enum big_numa   numa;
+int             nodes;      // NUMA nodes the policy spans, 0 if none was set
+};
+
+int Big_Alloc( struct big_block*, size_t, enum big_pages, enum big_numa );
+void Big_Free( struct big_block* );
+void Big_Describe( struct big_block*, char*, size_t );
+
+#endif
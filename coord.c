@@ -0,0 +1,1018 @@
+/* Public Domain.  See the LICENSE file.                                     */
+
+/* A coordinator for long jobs.  A job is split into independent work units  */
+/* which worker processes take from a shared directory, so a job can be      */
+/* spread over processes on one machine, or over machines that see the same  */
+/* directory (eg. over NFS), and a crash loses only the units in progress.   */
+/*                                                                           */
+/* Job kinds and their units:                                                */
+/*                                                                           */
+/*   count lo hi [size]           primes in lo .. hi, unit = size numbers    */
+/*   tf n lo hi [size]            trial factors of n in lo .. hi, unit =     */
+/*                                size numbers on wheel7 (210) boundaries    */
+/*   rho n seeds [iterations]     rho() with x^2 + c, one unit per c         */
+/*   ecm n B1 curves [per_unit]   ECM() curves, unit = per_unit sigmas       */
+/*                                                                           */
+/* The job directory holds:                                                  */
+/*                                                                           */
+/*   job        the job, as key=value lines                                  */
+/*   todo/      one empty file per unit waiting, named by unit number        */
+/*   claimed/   a unit a worker is on, renamed from todo/ as                 */
+/*              <unit>.<host>.<pid>.  rename() is atomic, so only one worker */
+/*              gets each unit                                               */
+/*   done/      results written by the workers                               */
+/*   journal    "<unit> <result>" for every finished unit, appended and      */
+/*              fsync'ed by the coordinator.  This is what makes a job       */
+/*              resumable                                                    */
+/*                                                                           */
+/* "coord run" starts local workers, moves results from done/ into the       */
+/* journal, replaces workers that die (putting their units back in todo/),   */
+/* and when every unit is in the journal merges the results in unit order,   */
+/* so the answer does not depend on which worker did what.  Run it again on  */
+/* an unfinished job to resume it.  "coord worker" joins a job from anywhere */
+/* else.  Counts are summed; divisors found by tf, rho or ecm units split n  */
+/* into coprime pieces, printed in the p^k.q format of WheelTF.              */
+
+/* To compile, the GMP library needs to be already installed.                */
+/* See https://gmplib.org                                                    */
+/* On linux, try:                                                            */
+/*   cc -O2 -DFACTOR_NO_MAIN coord.c factor_infos.c primality.c rho.c ecm.c  */
+/*      prime_iter.c profile.c -lgmp -lm -lpthread -o coord                  */
+
+/* eg. try:                                                                  */
+/*   ./coord init /tmp/job count 1 10000000000 1000000000                    */
+/*   ./coord run /tmp/job -w 4         --> 455052511                         */
+/*   ./coord init /tmp/job2 ecm 2535301200456458802993406410751 2000 100 10  */
+/*   ./coord run /tmp/job2             --> 7432339208719.341117531003194129  */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <gmp.h>
+
+#include "factor_infos.h"
+#include "primality.h"
+#include "rho.h"
+#include "ecm.h"
+#include "profile.h"
+
+#define COORD_DIR          1024
+#define COORD_PATH         4096
+#define COORD_RESULT       65536      // longest job file line, and first size of a result
+#define COORD_SEGMENT      262144     // numbers per sieve segment in a count unit,
+                                      // unless the profile sets coord.segment_size
+#define COORD_POLL_NSECS   100000000  // 0.1s between looks at done/
+#define COORD_MAX_WORKERS  256
+
+enum job_kind { JOB_COUNT, JOB_TF, JOB_RHO, JOB_ECM };
+
+const char* job_kind_names[] = { "count", "tf", "rho", "ecm" };
+
+struct coord_job {
+enum job_kind   kind;
+char            dir[COORD_DIR];
+mpz_t           n;                 // tf, rho, ecm
+uint64_t        lo, hi, size;      // count, tf
+unsigned long   seeds, iterations; // rho
+unsigned long   B1, curves, per_unit, sigma;  // ecm
+long            units;
+};
+
+// What a worker keeps between units
+struct coord_worker {
+uint32_t*       primes;            // count:  primes <= sqrt(hi)
+long            prime_count;
+uint8_t*        segment;
+uint64_t        segment_size;
+uint32_t        spokes[48];        // tf:  the wheel7 spokes 1 .. 209
+};
+
+// One unit's result line, grown as needed
+struct coord_result {
+char*           text;
+size_t          used;
+size_t          size;
+};
+
+int Init_Job( int, char**, const char* );
+int Read_Job( const char*, struct coord_job* );
+int Write_Job( struct coord_job* );
+long Unit_Count( struct coord_job* );
+int Run_Coordinator( struct coord_job*, int );
+int Run_Worker( struct coord_job* );
+int Claim_Unit( struct coord_job*, long*, char* );
+int Do_Unit( struct coord_job*, struct coord_worker*, long, struct coord_result* );
+uint64_t Count_Primes( struct coord_job*, struct coord_worker*, uint64_t, uint64_t );
+void Unit_TF( struct coord_job*, struct coord_worker*, long, struct coord_result* );
+void Unit_Rho( struct coord_job*, long, struct coord_result* );
+void Unit_ECM( struct coord_job*, long, struct coord_result* );
+void Append_Result( struct coord_result*, const char* );
+long Load_Journal( struct coord_job*, char** );
+int Append_Journal( FILE*, long, const char*, char** );
+long Collect_Done( struct coord_job*, FILE*, char** );
+void Requeue_Stale( struct coord_job*, char**, pid_t );
+int Units_Waiting( struct coord_job* );
+void Queue_Missing( struct coord_job*, char** );
+void Merge( struct coord_job*, char** );
+void Split_By_Divisor( struct factor_infos*, mpz_t );
+void Refine_Pieces( struct factor_infos* );
+uint32_t* Small_Primes( uint64_t, long* );
+uint64_t isqrt64( uint64_t );
+void Job_Path( struct coord_job*, char*, const char*, const char* );
+
+int main( int argc, char * argv[] ) {
+
+  if ( argc >= 4 && !strcmp( argv[1], "init" ) )
+    return Init_Job( argc - 3, argv + 3, argv[2] );
+
+  if ( argc >= 3 && (!strcmp( argv[1], "run" ) || !strcmp( argv[1], "worker" ) || !strcmp( argv[1], "status" )) ) {
+    struct coord_job job;
+    if ( !Read_Job( argv[2], &job ) ) {
+      fprintf( stderr, "Error: No job in %s. Aborting.\n\n", argv[2] );
+      return 1;
+    }
+
+    int retval = 0;
+    if ( !strcmp( argv[1], "worker" ) )
+      retval = Run_Worker( &job );
+    else if ( !strcmp( argv[1], "status" ) ) {
+      char** results = (char**) calloc( job.units, sizeof(char*) );
+      long finished = Load_Journal( &job, results );
+      printf( "%s job, %ld of %ld units finished\n", job_kind_names[job.kind], finished, job.units );
+      long u;
+      for ( u = 0; u < job.units; u++ )
+        free( results[u] );
+      free( results );
+    }
+    else {
+      int workers = (int) sysconf( _SC_NPROCESSORS_ONLN );
+      if ( argc == 5 && !strcmp( argv[3], "-w" ) )
+        workers = atoi( argv[4] );
+      if ( workers < 0 )
+        workers = 0;
+      if ( workers > COORD_MAX_WORKERS )
+        workers = COORD_MAX_WORKERS;
+      retval = Run_Coordinator( &job, workers );
+    }
+
+    mpz_clear( job.n );
+    return retval;
+  }
+
+  printf( "\nUsage: coord init dir count lo hi [size]\n" );
+  printf( "       coord init dir tf n lo hi [size]\n" );
+  printf( "       coord init dir rho n seeds [iterations]\n" );
+  printf( "       coord init dir ecm n B1 curves [curves_per_unit]\n" );
+  printf( "       coord run dir [-w workers]    run (or resume) with local workers, then print the result\n" );
+  printf( "       coord worker dir              work on the job from another process or machine\n" );
+  printf( "       coord status dir\n\n" );
+  return 1;
+}
+
+// "coord init dir kind args...".  Creates the job directory and its units.
+int Init_Job( int argc, char** argv, const char* dir ) {
+  struct coord_job job;
+  memset( &job, 0, sizeof(job) );
+  mpz_init( job.n );
+  snprintf( job.dir, sizeof(job.dir), "%s", dir );
+
+  int ok = 0;
+  if ( !strcmp( argv[0], "count" ) && (argc == 3 || argc == 4) ) {
+    job.kind = JOB_COUNT;
+    job.lo = strtoull( argv[1], NULL, 10 );
+    job.hi = strtoull( argv[2], NULL, 10 );
+    job.size = argc == 4 ? strtoull( argv[3], NULL, 10 ) : 1000000000ull;
+    ok = job.lo <= job.hi && job.hi <= 1000000000000000000ull && job.size > 0;
+  }
+  else if ( !strcmp( argv[0], "tf" ) && (argc == 4 || argc == 5) ) {
+    job.kind = JOB_TF;
+    ok = mpz_set_str( job.n, argv[1], 10 ) == 0 && mpz_cmp_ui( job.n, 2 ) >= 0;
+    job.lo = strtoull( argv[2], NULL, 10 );
+    job.hi = strtoull( argv[3], NULL, 10 );
+    job.size = argc == 5 ? strtoull( argv[4], NULL, 10 ) : 100000000ull;
+    // units start on multiples of 210 so each one covers whole turns of the wheel
+    job.size = (job.size + 209) / 210 * 210;
+    ok = ok && job.lo >= 2 && job.lo <= job.hi && job.hi < 0xFFFFFFFFFFFFFF00ull;
+  }
+  else if ( !strcmp( argv[0], "rho" ) && (argc == 3 || argc == 4) ) {
+    job.kind = JOB_RHO;
+    ok = mpz_set_str( job.n, argv[1], 10 ) == 0 && mpz_cmp_ui( job.n, 4 ) >= 0;
+    job.seeds = strtoul( argv[2], NULL, 10 );
+    job.iterations = argc == 4 ? strtoul( argv[3], NULL, 10 ) : 1000000;
+    ok = ok && job.seeds > 0;
+  }
+  else if ( !strcmp( argv[0], "ecm" ) && (argc == 4 || argc == 5) ) {
+    job.kind = JOB_ECM;
+    ok = mpz_set_str( job.n, argv[1], 10 ) == 0 && mpz_cmp_ui( job.n, 4 ) >= 0;
+    job.B1 = strtoul( argv[2], NULL, 10 );
+    job.curves = strtoul( argv[3], NULL, 10 );
+    job.per_unit = argc == 5 ? strtoul( argv[4], NULL, 10 ) : 10;
+    job.sigma = 7;
+    ok = ok && job.B1 > 0 && job.curves > 0 && job.per_unit > 0;
+  }
+
+  if ( !ok ) {
+    fprintf( stderr, "Error: Bad job.  Run coord without arguments for usage. Aborting.\n\n" );
+    mpz_clear( job.n );
+    return 1;
+  }
+
+  job.units = Unit_Count( &job );
+
+  char path[COORD_PATH];
+  if ( mkdir( job.dir, 0777 ) != 0 && errno != EEXIST ) {
+    fprintf( stderr, "Error: Cannot create %s. Aborting.\n\n", job.dir );
+    mpz_clear( job.n );
+    return 1;
+  }
+  Job_Path( &job, path, "job", NULL );
+  if ( access( path, F_OK ) == 0 ) {
+    fprintf( stderr, "Error: %s already holds a job. Aborting.\n\n", job.dir );
+    mpz_clear( job.n );
+    return 1;
+  }
+
+  const char* subdirs[3] = { "todo", "claimed", "done" };
+  int i;
+  for ( i = 0; i < 3; i++ ) {
+    Job_Path( &job, path, subdirs[i], NULL );
+    mkdir( path, 0777 );
+  }
+
+  // the units go in before the job file, so a job file means a whole job
+  char** results = (char**) calloc( job.units, sizeof(char*) );
+  Queue_Missing( &job, results );
+  free( results );
+
+  if ( !Write_Job( &job ) ) {
+    fprintf( stderr, "Error: Cannot write the job file. Aborting.\n\n" );
+    mpz_clear( job.n );
+    return 1;
+  }
+
+  printf( "%s job with %ld units in %s\n", job_kind_names[job.kind], job.units, job.dir );
+  mpz_clear( job.n );
+  return 0;
+}
+
+long Unit_Count( struct coord_job* job ) {
+  switch ( job->kind ) {
+  case JOB_COUNT:
+    return (long) ((job->hi - job->lo) / job->size + 1);
+  case JOB_TF:
+    return (long) ((job->hi - job->lo / 210 * 210) / job->size + 1);
+  case JOB_RHO:
+    return (long) job->seeds;
+  case JOB_ECM:
+    return (long) ((job->curves + job->per_unit - 1) / job->per_unit);
+  }
+  return 0;
+}
+
+int Write_Job( struct coord_job* job ) {
+  char path[COORD_PATH], tmp[COORD_PATH];
+  Job_Path( job, path, "job", NULL );
+  Job_Path( job, tmp, "job.tmp", NULL );
+
+  FILE* f = fopen( tmp, "w" );
+  if ( f == NULL )
+    return 0;
+  fprintf( f, "kind=%s\n", job_kind_names[job->kind] );
+  gmp_fprintf( f, "n=%Zd\n", job->n );
+  fprintf( f, "lo=%ju\nhi=%ju\nsize=%ju\n", (uintmax_t) job->lo, (uintmax_t) job->hi, (uintmax_t) job->size );
+  fprintf( f, "seeds=%lu\niterations=%lu\n", job->seeds, job->iterations );
+  fprintf( f, "B1=%lu\ncurves=%lu\nper_unit=%lu\nsigma=%lu\n", job->B1, job->curves, job->per_unit, job->sigma );
+  fprintf( f, "units=%ld\n", job->units );
+  fflush( f );
+  fsync( fileno( f ) );
+  fclose( f );
+
+  return rename( tmp, path ) == 0;
+}
+
+int Read_Job( const char* dir, struct coord_job* job ) {
+  memset( job, 0, sizeof(struct coord_job) );
+  mpz_init( job->n );
+  snprintf( job->dir, sizeof(job->dir), "%s", dir );
+
+  char path[COORD_PATH];
+  Job_Path( job, path, "job", NULL );
+  FILE* f = fopen( path, "r" );
+  if ( f == NULL )
+    return 0;
+
+  char line[COORD_RESULT];
+  int kind = -1;
+  while ( fgets( line, sizeof(line), f ) != NULL ) {
+    char* value = strchr( line, '=' );
+    if ( value == NULL )
+      continue;
+    *value++ = '\0';
+    value[strcspn( value, "\n" )] = '\0';
+
+    if ( !strcmp( line, "kind" ) ) {
+      int k;
+      for ( k = 0; k < 4; k++ )
+        if ( !strcmp( value, job_kind_names[k] ) )
+          kind = k;
+    }
+    else if ( !strcmp( line, "n" ) )
+      mpz_set_str( job->n, value, 10 );
+    else if ( !strcmp( line, "lo" ) )
+      job->lo = strtoull( value, NULL, 10 );
+    else if ( !strcmp( line, "hi" ) )
+      job->hi = strtoull( value, NULL, 10 );
+    else if ( !strcmp( line, "size" ) )
+      job->size = strtoull( value, NULL, 10 );
+    else if ( !strcmp( line, "seeds" ) )
+      job->seeds = strtoul( value, NULL, 10 );
+    else if ( !strcmp( line, "iterations" ) )
+      job->iterations = strtoul( value, NULL, 10 );
+    else if ( !strcmp( line, "B1" ) )
+      job->B1 = strtoul( value, NULL, 10 );
+    else if ( !strcmp( line, "curves" ) )
+      job->curves = strtoul( value, NULL, 10 );
+    else if ( !strcmp( line, "per_unit" ) )
+      job->per_unit = strtoul( value, NULL, 10 );
+    else if ( !strcmp( line, "sigma" ) )
+      job->sigma = strtoul( value, NULL, 10 );
+    else if ( !strcmp( line, "units" ) )
+      job->units = strtol( value, NULL, 10 );
+  }
+  fclose( f );
+
+  if ( kind < 0 || job->units <= 0 )
+    return 0;
+  job->kind = (enum job_kind) kind;
+  return job->units == Unit_Count( job );
+}
+
+// Start workers, journal what they finish, and merge at the end.  With 0
+// workers it only collects what workers started elsewhere send in.
+int Run_Coordinator( struct coord_job* job, int workers ) {
+  char** results = (char**) calloc( job->units, sizeof(char*) );
+  if ( results == NULL ) {
+    fprintf( stderr, "Error: Failed to allocate memory. Aborting.\n\n" );
+    return 1;
+  }
+
+  long finished = Load_Journal( job, results );
+
+  char path[COORD_PATH];
+  Job_Path( job, path, "journal", NULL );
+  FILE* journal = fopen( path, "a" );
+  if ( journal == NULL ) {
+    fprintf( stderr, "Error: Cannot open %s. Aborting.\n\n", path );
+    free( results );
+    return 1;
+  }
+
+  // results from before a crash, and units no longer anywhere
+  finished += Collect_Done( job, journal, results );
+  Queue_Missing( job, results );
+
+  pid_t pids[COORD_MAX_WORKERS];
+  memset( pids, 0, sizeof(pids) );
+
+  struct timespec poll = { 0, COORD_POLL_NSECS };
+  long polls = 0;
+  int w;
+  while ( finished < job->units ) {
+    finished += Collect_Done( job, journal, results );
+
+    // a worker that died leaves its unit claimed.  Put it back
+    for ( w = 0; w < workers; w++ ) {
+      int status;
+      if ( pids[w] <= 0 || waitpid( pids[w], &status, WNOHANG ) != pids[w] )
+        continue;
+      pid_t dead = pids[w];
+      pids[w] = 0;
+      if ( WIFEXITED( status ) && WEXITSTATUS( status ) == 0 )
+        continue;
+      fprintf( stderr, "Worker %d died, requeueing its unit.\n", (int) dead );
+      finished += Collect_Done( job, journal, results );
+      Requeue_Stale( job, results, dead );
+    }
+
+    // now and then, look for units left by workers from an earlier run
+    if ( polls++ % 10 == 0 )
+      Requeue_Stale( job, results, 0 );
+
+    // (re)start workers while there is something for them to do
+    for ( w = 0; w < workers && finished < job->units && Units_Waiting( job ); w++ ) {
+      if ( pids[w] > 0 )
+        continue;
+      pids[w] = fork();
+      if ( pids[w] == 0 )
+        _exit( Run_Worker( job ) );
+    }
+
+    if ( finished < job->units )
+      nanosleep( &poll, NULL );
+  }
+
+  for ( w = 0; w < workers; w++ )
+    if ( pids[w] > 0 )
+      waitpid( pids[w], NULL, 0 );
+
+  fclose( journal );
+
+  Merge( job, results );
+
+  long u;
+  for ( u = 0; u < job->units; u++ )
+    free( results[u] );
+  free( results );
+
+  return 0;
+}
+
+// Take units from todo/ until there are none left
+int Run_Worker( struct coord_job* job ) {
+  struct coord_worker worker;
+  memset( &worker, 0, sizeof(worker) );
+
+  if ( job->kind == JOB_COUNT ) {
+    worker.primes = Small_Primes( isqrt64( job->hi ) + 1, &worker.prime_count );
+    worker.segment_size = (uint64_t) Profile_Get( "coord.segment_size", COORD_SEGMENT );
+    if ( worker.segment_size < 1024 )
+      worker.segment_size = COORD_SEGMENT;
+    worker.segment = (uint8_t*) malloc( worker.segment_size );
+    if ( worker.primes == NULL || worker.segment == NULL ) {
+      fprintf( stderr, "Error: Failed to allocate memory. Aborting.\n\n" );
+      return 1;
+    }
+  }
+
+  if ( job->kind == JOB_TF ) {
+    uint32_t s;
+    int k = 0;
+    for ( s = 1; s < 210; s++ )
+      if ( s % 2 && s % 3 && s % 5 && s % 7 )
+        worker.spokes[k++] = s;
+  }
+
+  struct coord_result result;
+  result.size = COORD_RESULT;
+  result.text = (char*) malloc( result.size );
+  long unit;
+  char claimed[COORD_PATH];
+  while ( result.text != NULL && Claim_Unit( job, &unit, claimed ) ) {
+    result.used = 0;
+    result.text[0] = '\0';
+    if ( !Do_Unit( job, &worker, unit, &result ) )
+      break;
+
+    // write then rename, so done/ never holds half a result
+    char tmp[COORD_PATH], name[32], done[COORD_PATH];
+    snprintf( name, sizeof(name), "%ld.tmp.%d", unit, (int) getpid() );
+    Job_Path( job, tmp, "done", name );
+    snprintf( name, sizeof(name), "%ld", unit );
+    Job_Path( job, done, "done", name );
+
+    FILE* f = fopen( tmp, "w" );
+    if ( f == NULL )
+      break;
+    fprintf( f, "%s\n", result.text );
+    fflush( f );
+    fsync( fileno( f ) );
+    fclose( f );
+    rename( tmp, done );
+    unlink( claimed );
+  }
+
+  free( result.text );
+  free( worker.segment );
+  free( worker.primes );
+
+  return 0;
+}
+
+// Move some unit from todo/ to claimed/.  Returns 0 when there are none.
+int Claim_Unit( struct coord_job* job, long* unit, char* claimed ) {
+  char dir[COORD_PATH], host[256];
+  Job_Path( job, dir, "todo", NULL );
+  if ( gethostname( host, sizeof(host) ) != 0 )
+    strcpy( host, "localhost" );
+  host[sizeof(host) - 1] = '\0';
+
+  DIR* d = opendir( dir );
+  if ( d == NULL )
+    return 0;
+
+  int found = 0;
+  struct dirent* entry;
+  while ( !found && (entry = readdir( d )) != NULL ) {
+    if ( entry->d_name[0] == '.' )
+      continue;
+
+    char from[COORD_PATH], name[512];
+    Job_Path( job, from, "todo", entry->d_name );
+    snprintf( name, sizeof(name), "%s.%s.%d", entry->d_name, host, (int) getpid() );
+    Job_Path( job, claimed, "claimed", name );
+
+    // someone else may have got there first
+    if ( rename( from, claimed ) == 0 ) {
+      *unit = strtol( entry->d_name, NULL, 10 );
+      found = 1;
+    }
+  }
+  closedir( d );
+
+  return found;
+}
+
+// Work out one unit.  The result is a single line of text, "-" if empty.
+int Do_Unit( struct coord_job* job, struct coord_worker* worker, long unit, struct coord_result* result ) {
+  switch ( job->kind ) {
+  case JOB_COUNT: {
+    uint64_t from = job->lo + (uint64_t) unit * job->size;
+    uint64_t to = job->hi - from < job->size - 1 ? job->hi : from + job->size - 1;
+    char count[24];
+    snprintf( count, sizeof(count), "%ju", (uintmax_t) Count_Primes( job, worker, from, to ) );
+    Append_Result( result, count );
+    break;
+  }
+  case JOB_TF:
+    Unit_TF( job, worker, unit, result );
+    break;
+  case JOB_RHO:
+    Unit_Rho( job, unit, result );
+    break;
+  case JOB_ECM:
+    Unit_ECM( job, unit, result );
+    break;
+  default:
+    return 0;
+  }
+
+  if ( result->used == 0 )
+    Append_Result( result, "-" );
+  return 1;
+}
+
+// Add text to the result, space separated, growing it as needed
+void Append_Result( struct coord_result* result, const char* text ) {
+  size_t length = strlen( text );
+  size_t need = result->used + length + 2;
+  if ( need > result->size ) {
+    size_t grown = 2 * result->size > need ? 2 * result->size : need;
+    char* bigger = (char*) realloc( result->text, grown );
+    if ( bigger == NULL ) {
+      fprintf( stderr, "Error: Failed to allocate memory. Aborting.\n\n" );
+      exit( 1 );
+    }
+    result->text = bigger;
+    result->size = grown;
+  }
+  if ( result->used > 0 )
+    result->text[result->used++] = ' ';
+  memcpy( result->text + result->used, text, length + 1 );
+  result->used += length;
+}
+
+// Segmented Sieve of Eratosthenes over from .. to
+uint64_t Count_Primes( struct coord_job* job, struct coord_worker* worker, uint64_t from, uint64_t to ) {
+  (void) job;
+  uint64_t count = 0;
+  uint64_t seg;
+  for ( seg = from; seg <= to; seg += worker->segment_size ) {
+    uint64_t length = to - seg + 1 < worker->segment_size ? to - seg + 1 : worker->segment_size;
+    uint64_t top = seg + length - 1;
+    memset( worker->segment, 1, length );
+
+    long k;
+    for ( k = 0; k < worker->prime_count; k++ ) {
+      uint64_t p = worker->primes[k];
+      if ( p * p > top )
+        break;
+      uint64_t j = (seg + p - 1) / p * p;
+      if ( j < p * p )
+        j = p * p;
+      for ( ; j <= top; j += p )
+        worker->segment[j - seg] = 0;
+    }
+
+    uint64_t i;
+    for ( i = 0; i < length; i++ )
+      if ( worker->segment[i] && seg + i >= 2 )
+        count++;
+
+    if ( top == to )
+      break;
+  }
+  return count;
+}
+
+// Trial divide n by the wheel7 candidates in this unit's interval, and by
+// 2, 3, 5 and 7 in the first one.  The result lists the divisors found.
+void Unit_TF( struct coord_job* job, struct coord_worker* worker, long unit, struct coord_result* result ) {
+  uint64_t base = job->lo / 210 * 210 + (uint64_t) unit * job->size;
+  uint64_t top = job->hi - base < job->size - 1 ? job->hi : base + job->size - 1;
+  char number[24];
+
+  if ( unit == 0 ) {
+    const uint64_t small[4] = { 2, 3, 5, 7 };
+    int i;
+    for ( i = 0; i < 4; i++ )
+      if ( small[i] >= job->lo && small[i] <= job->hi && mpz_divisible_ui_p( job->n, small[i] ) ) {
+        snprintf( number, sizeof(number), "%ju", (uintmax_t) small[i] );
+        Append_Result( result, number );
+      }
+  }
+
+  uint64_t turn;
+  for ( turn = base; turn <= top; turn += 210 ) {
+    int s;
+    for ( s = 0; s < 48; s++ ) {
+      uint64_t candidate = turn + worker->spokes[s];
+      if ( candidate < job->lo || candidate > top || candidate == 1 )
+        continue;
+      if ( mpz_divisible_ui_p( job->n, candidate ) ) {
+        snprintf( number, sizeof(number), "%ju", (uintmax_t) candidate );
+        Append_Result( result, number );
+      }
+    }
+  }
+}
+
+// Rho with c = unit + 1
+void Unit_Rho( struct coord_job* job, long unit, struct coord_result* result ) {
+  mpz_t d;
+  mpz_init( d );
+  if ( Rho( job->n, (unsigned long) unit + 1, (long) job->iterations, d ) ) {
+    char* text = mpz_get_str( NULL, 10, d );
+    Append_Result( result, text );
+    free( text );
+  }
+  mpz_clear( d );
+}
+
+// This unit's curves, one thread, since the workers are processes
+void Unit_ECM( struct coord_job* job, long unit, struct coord_result* result ) {
+  unsigned long first = (unsigned long) unit * job->per_unit;
+  long curves = (long) (job->curves - first < job->per_unit ? job->curves - first : job->per_unit);
+
+  struct factor_infos Factor_Infos;
+  Init_Factor_Infos( &Factor_Infos );
+
+  if ( ECM( job->n, job->B1, 100 * job->B1, job->sigma + first, curves, 1, &Factor_Infos ) == 'F' ) {
+    long i;
+    for ( i = 0; i < Factor_Infos.count; i++ ) {
+      char* text = mpz_get_str( NULL, 10, Factor_Infos.the_factors[i].the_factor );
+      Append_Result( result, text );
+      free( text );
+    }
+  }
+
+  Cleanup_Factor_Infos( &Factor_Infos );
+}
+
+// Read the journal into results.  A torn last line (a crash mid-write) is
+// cut off.  Returns the number of finished units.
+long Load_Journal( struct coord_job* job, char** results ) {
+  char path[COORD_PATH];
+  Job_Path( job, path, "journal", NULL );
+  FILE* f = fopen( path, "r" );
+  if ( f == NULL )
+    return 0;
+
+  long finished = 0;
+  long good_bytes = 0;
+  char* line = NULL;
+  size_t line_size = 0;
+  ssize_t length;
+  while ( (length = getline( &line, &line_size, f )) > 0 ) {
+    if ( line[length - 1] != '\n' )
+      break;
+    good_bytes += (long) length;
+    line[length - 1] = '\0';
+
+    char* space = strchr( line, ' ' );
+    if ( space == NULL )
+      continue;
+    long unit = strtol( line, NULL, 10 );
+    if ( unit < 0 || unit >= job->units || results[unit] != NULL )
+      continue;
+    results[unit] = strdup( space + 1 );
+    finished++;
+  }
+  free( line );
+  fclose( f );
+
+  if ( truncate( path, good_bytes ) != 0 )
+    fprintf( stderr, "Warning: Cannot trim %s.\n", path );
+
+  return finished;
+}
+
+// One line per unit, synced before the done/ file that it came from goes
+int Append_Journal( FILE* journal, long unit, const char* result, char** results ) {
+  if ( results[unit] != NULL )
+    return 0;
+  fprintf( journal, "%ld %s\n", unit, result );
+  fflush( journal );
+  fsync( fileno( journal ) );
+  results[unit] = strdup( result );
+  return 1;
+}
+
+// Journal whatever results are waiting in done/.  Returns how many were new.
+long Collect_Done( struct coord_job* job, FILE* journal, char** results ) {
+  char dir[COORD_PATH];
+  Job_Path( job, dir, "done", NULL );
+  DIR* d = opendir( dir );
+  if ( d == NULL )
+    return 0;
+
+  long added = 0;
+  char* line = NULL;
+  size_t line_size = 0;
+  struct dirent* entry;
+  while ( (entry = readdir( d )) != NULL ) {
+    // skip ".", ".." and anything still being written
+    if ( entry->d_name[0] == '.' || strchr( entry->d_name, '.' ) != NULL )
+      continue;
+
+    long unit = strtol( entry->d_name, NULL, 10 );
+    char path[COORD_PATH];
+    Job_Path( job, path, "done", entry->d_name );
+    if ( unit < 0 || unit >= job->units ) {
+      unlink( path );
+      continue;
+    }
+
+    FILE* f = fopen( path, "r" );
+    if ( f == NULL )
+      continue;
+    int ok = getline( &line, &line_size, f ) > 0;
+    fclose( f );
+    if ( !ok )
+      continue;
+    line[strcspn( line, "\n" )] = '\0';
+
+    added += Append_Journal( journal, unit, line, results );
+    unlink( path );
+  }
+  free( line );
+  closedir( d );
+
+  return added;
+}
+
+// Put claimed units back in todo/ when the worker that claimed them (on this
+// host) is gone:  pid dead, or any dead pid if dead == 0.
+void Requeue_Stale( struct coord_job* job, char** results, pid_t dead ) {
+  char dir[COORD_PATH], host[256];
+  Job_Path( job, dir, "claimed", NULL );
+  if ( gethostname( host, sizeof(host) ) != 0 )
+    strcpy( host, "localhost" );
+  host[sizeof(host) - 1] = '\0';
+
+  DIR* d = opendir( dir );
+  if ( d == NULL )
+    return;
+
+  struct dirent* entry;
+  while ( (entry = readdir( d )) != NULL ) {
+    if ( entry->d_name[0] == '.' )
+      continue;
+
+    // <unit>.<host>.<pid>
+    char* first = strchr( entry->d_name, '.' );
+    char* last = strrchr( entry->d_name, '.' );
+    if ( first == NULL || last == first )
+      continue;
+    if ( (size_t) (last - first - 1) != strlen( host ) || strncmp( first + 1, host, last - first - 1 ) )
+      continue;
+
+    pid_t pid = (pid_t) strtol( last + 1, NULL, 10 );
+    if ( dead != 0 ? pid != dead : kill( pid, 0 ) == 0 || errno != ESRCH )
+      continue;
+
+    char from[COORD_PATH], to[COORD_PATH], name[32];
+    long unit = strtol( entry->d_name, NULL, 10 );
+    Job_Path( job, from, "claimed", entry->d_name );
+    snprintf( name, sizeof(name), "%ld", unit );
+    Job_Path( job, to, "todo", name );
+    if ( unit >= 0 && unit < job->units && results[unit] == NULL )
+      rename( from, to );
+    else
+      unlink( from );
+  }
+  closedir( d );
+}
+
+// Is there anything in todo/?
+int Units_Waiting( struct coord_job* job ) {
+  char dir[COORD_PATH];
+  Job_Path( job, dir, "todo", NULL );
+  DIR* d = opendir( dir );
+  if ( d == NULL )
+    return 0;
+
+  int waiting = 0;
+  struct dirent* entry;
+  while ( !waiting && (entry = readdir( d )) != NULL )
+    waiting = entry->d_name[0] != '.';
+  closedir( d );
+
+  return waiting;
+}
+
+// Make sure every unfinished unit is in todo/, claimed/ or done/
+void Queue_Missing( struct coord_job* job, char** results ) {
+  char* present = (char*) calloc( job->units, 1 );
+  if ( present == NULL )
+    return;
+
+  const char* subdirs[3] = { "todo", "claimed", "done" };
+  int i;
+  for ( i = 0; i < 3; i++ ) {
+    char dir[COORD_PATH];
+    Job_Path( job, dir, subdirs[i], NULL );
+    DIR* d = opendir( dir );
+    if ( d == NULL )
+      continue;
+    struct dirent* entry;
+    while ( (entry = readdir( d )) != NULL ) {
+      if ( entry->d_name[0] == '.' )
+        continue;
+      long unit = strtol( entry->d_name, NULL, 10 );
+      if ( unit >= 0 && unit < job->units )
+        present[unit] = 1;
+    }
+    closedir( d );
+  }
+
+  long unit;
+  for ( unit = 0; unit < job->units; unit++ ) {
+    if ( present[unit] || results[unit] != NULL )
+      continue;
+    char path[COORD_PATH], name[32];
+    snprintf( name, sizeof(name), "%ld", unit );
+    Job_Path( job, path, "todo", name );
+    int fd = open( path, O_WRONLY | O_CREAT, 0666 );
+    if ( fd >= 0 )
+      close( fd );
+  }
+
+  free( present );
+}
+
+// Combine the results, in unit order, and print them
+void Merge( struct coord_job* job, char** results ) {
+  long unit;
+
+  if ( job->kind == JOB_COUNT ) {
+    uint64_t total = 0;
+    for ( unit = 0; unit < job->units; unit++ )
+      total += strtoull( results[unit], NULL, 10 );
+    printf( "\nTotal number of primes from %ju to %ju: %ju\n\n", (uintmax_t) job->lo, (uintmax_t) job->hi,
+            (uintmax_t) total );
+    return;
+  }
+
+  struct factor_infos pieces;
+  Init_Factor_Infos( &pieces );
+  AddFactorInfo( &pieces, job->n, 1, 'C' );
+
+  mpz_t d;
+  mpz_init( d );
+  for ( unit = 0; unit < job->units; unit++ ) {
+    char* s = results[unit];
+    while ( *s != '\0' ) {
+      char* end = s + strcspn( s, " " );
+      char saved = *end;
+      *end = '\0';
+      if ( mpz_set_str( d, s, 10 ) == 0 )
+        Split_By_Divisor( &pieces, d );
+      *end = saved;
+      s = saved ? end + 1 : end;
+    }
+  }
+  mpz_clear( d );
+
+  Refine_Pieces( &pieces );
+
+  long i;
+  for ( i = 0; i < pieces.count; i++ )
+    pieces.the_factors[i].factor_status = quickprimecheck( pieces.the_factors[i].the_factor );
+  Sort_Factor_Infos( &pieces );
+
+  Print_Factor_Infos( &pieces );
+  printf( "\n" );
+
+  Cleanup_Factor_Infos( &pieces );
+}
+
+// Split every piece that d shares a proper factor with
+void Split_By_Divisor( struct factor_infos* pieces, mpz_t d ) {
+  mpz_t g;
+  mpz_init( g );
+  long i, count = pieces->count;
+  for ( i = 0; i < count; i++ ) {
+    mpz_gcd( g, pieces->the_factors[i].the_factor, d );
+    if ( mpz_cmp_ui( g, 1 ) == 0 || mpz_cmp( g, pieces->the_factors[i].the_factor ) == 0 )
+      continue;
+    mpz_divexact( pieces->the_factors[i].the_factor, pieces->the_factors[i].the_factor, g );
+    AddFactorInfo( pieces, g, 1, 'C' );
+  }
+  mpz_clear( g );
+}
+
+// Split pieces against each other until any two are equal or coprime.  The
+// product stays n, and equal pieces become one p^k entry when sorted.
+void Refine_Pieces( struct factor_infos* pieces ) {
+  mpz_t g;
+  mpz_init( g );
+  int changed = 1;
+  while ( changed ) {
+    changed = 0;
+    long i, j;
+    for ( i = 0; i < pieces->count && !changed; i++ ) {
+      for ( j = i + 1; j < pieces->count && !changed; j++ ) {
+        mpz_ptr a = pieces->the_factors[i].the_factor;
+        mpz_ptr b = pieces->the_factors[j].the_factor;
+        if ( mpz_cmp( a, b ) == 0 )
+          continue;
+        mpz_gcd( g, a, b );
+        if ( mpz_cmp_ui( g, 1 ) == 0 )
+          continue;
+        // a.b == g.(a/g).g.(b/g)
+        mpz_divexact( a, a, g );
+        mpz_divexact( b, b, g );
+        AddFactorInfo( pieces, g, 1, 'C' );
+        AddFactorInfo( pieces, g, 1, 'C' );
+        changed = 1;
+      }
+    }
+    // drop the 1s left behind
+    long k, kept = 0;
+    for ( k = 0; k < pieces->count; k++ ) {
+      if ( mpz_cmp_ui( pieces->the_factors[k].the_factor, 1 ) == 0 )
+        continue;
+      mpz_swap( pieces->the_factors[kept].the_factor, pieces->the_factors[k].the_factor );
+      pieces->the_factors[kept].occurrences = pieces->the_factors[k].occurrences;
+      kept++;
+    }
+    pieces->count = kept;
+  }
+  mpz_clear( g );
+}
+
+// Primes up to limit, or NULL if out of memory
+uint32_t* Small_Primes( uint64_t limit, long* count ) {
+  uint8_t* composite = (uint8_t*) calloc( limit + 1, 1 );
+  if ( composite == NULL )
+    return NULL;
+
+  uint64_t i, j;
+  *count = 0;
+  for ( i = 2; i <= limit; i++ ) {
+    if ( composite[i] )
+      continue;
+    (*count)++;
+    for ( j = i * i; j <= limit; j += i )
+      composite[j] = 1;
+  }
+
+  uint32_t* primes = (uint32_t*) malloc( (*count + 1) * sizeof(uint32_t) );
+  if ( primes != NULL ) {
+    long k = 0;
+    for ( i = 2; i <= limit; i++ )
+      if ( !composite[i] )
+        primes[k++] = (uint32_t) i;
+  }
+  free( composite );
+  return primes;
+}
+
+uint64_t isqrt64( uint64_t n ) {
+  uint64_t r = (uint64_t) sqrtl( (long double) n );
+  while ( r * r > n )
+    r--;
+  while ( (r + 1) * (r + 1) <= n )
+    r++;
+  return r;
+}
+
+// dir/sub or dir/sub/name
+void Job_Path( struct coord_job* job, char* path, const char* sub, const char* name ) {
+  if ( name == NULL )
+    snprintf( path, COORD_PATH, "%s/%s", job->dir, sub );
+  else
+    snprintf( path, COORD_PATH, "%s/%s/%s", job->dir, sub, name );
+}
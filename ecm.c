@@ -0,0 +1,529 @@
+/* Public Domain.  See the LICENSE file.                                     */
+
+/* Lenstra's Elliptic Curve Method (ECM) of factorization.                   */
+/* https://en.wikipedia.org/wiki/Lenstra_elliptic-curve_factorization        */
+
+/* Curves are in Montgomery form  B.y^2 = x^3 + A.x^2 + x  using Suyama's    */
+/* parameterization, and only the x and z coordinates are ever tracked.      */
+/* Stage 1 multiplies the starting point by every prime power <= B1 using    */
+/* the Montgomery ladder.  Stage 2 is a baby-step/giant-step continuation    */
+/* covering each prime B1 < p <= B2 written as p = k.D +/- j (stage 1 takes  */
+/* the primes up to D/2 if B1 is below that).  The primes                    */
+/* come from a prime_iter (see prime_iter.c) per thread, so no table of the  */
+/* primes up to B2 is kept.                                                  */
+/* Curves are run in parallel, one per thread, and all threads stop as soon  */
+/* as any one of them finds a factor.                                        */
+
+/* To compile, the GMP library needs to be already installed.                */
+/* See https://gmplib.org                                                    */
+/* On linux, try:                                                            */
+/*   cc ecm.c factor_infos.c primality.c prime_iter.c -lgmp -lpthread -o ecm */
+/* Build with -DFACTOR_NO_MAIN to link ECM() into another program.           */
+
+/* Some test numbers:                                                        */
+/* ecm 1000000016000000063                   --> 1000000007.1000000009       */
+/* ecm 2535301200456458802993406410751   (2^101 - 1)                         */
+/*                             --> 7432339208719.341117531003194129          */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <gmp.h>
+
+#include "factor_infos.h"
+#include "ecm.h"
+#include "prime_iter.h"
+
+// The usual B1 and curve count for finding a factor of a given size.
+// Taken from the GMP-ECM README table.  Our stage 2 uses B2 = 100 * B1,
+// which is smaller than GMP-ECM's default B2, so these curve counts are
+// on the optimistic side.
+struct ecm_level {
+int             digits;
+unsigned long   B1;
+long            curves;
+};
+
+static const struct ecm_level ecm_levels[] = { { 15,     2000,    25 },
+                                               { 20,    11000,    90 },
+                                               { 25,    50000,   300 },
+                                               { 30,   250000,   700 },
+                                               { 35,  1000000,  1800 },
+                                               { 40,  3000000,  5100 },
+                                               { 45, 11000000, 10600 } };
+static const int ecm_levels_count = sizeof(ecm_levels) / sizeof(ecm_levels[0]);
+
+// Stage 2 giant step.  2310 = 2.3.5.7.11
+#define ECM_D 2310
+
+// x:z projective point
+struct ecm_point {
+mpz_t           x;
+mpz_t           z;
+};
+
+// Per thread curve state.  All temporaries are allocated once per thread.
+struct ecm_curve {
+mpz_t           n;
+mpz_t           a24;      // (A + 2) / 4
+mpz_t           u, v, w, t;
+mpz_t           acc;      // stage 2 product accumulator
+struct ecm_point  R0, R1, Q, base;
+struct prime_iter primes;
+};
+
+// Shared between the worker threads
+struct ecm_job {
+mpz_t           n;
+unsigned long   B1;
+unsigned long   B2;
+unsigned long   first_sigma;
+long            curves;
+long            next_curve;
+volatile int    stop;
+mpz_t           factor;
+pthread_mutex_t lock;
+};
+
+static void* ECM_Worker( void* );
+static int ECM_Curve( struct ecm_job*, struct ecm_curve*, unsigned long, mpz_t );
+static int ECM_Stage2( struct ecm_job*, struct ecm_curve*, mpz_t );
+static unsigned long Stage1_Top( struct ecm_job* );
+static void xDBL( struct ecm_curve*, struct ecm_point*, struct ecm_point* );
+static void xADD( struct ecm_curve*, struct ecm_point*, struct ecm_point*, struct ecm_point*, struct ecm_point* );
+static void Ladder( struct ecm_curve*, struct ecm_point*, struct ecm_point*, unsigned long );
+
+#ifndef FACTOR_NO_MAIN
+int main( int argc, char * argv[] ) {
+
+  int threads = (int) sysconf( _SC_NPROCESSORS_ONLN );
+  unsigned long B1 = 0;
+  long curves = 0;
+  int max_digits = 35;
+
+  int argi = 1;
+  for ( ; argi < argc - 1; argi += 2 ) {
+    if ( !strcmp( argv[argi], "-t" ) )
+      threads = atoi( argv[argi+1] );
+    else if ( !strcmp( argv[argi], "-B1" ) )
+      B1 = strtoul( argv[argi+1], NULL, 10 );
+    else if ( !strcmp( argv[argi], "-c" ) )
+      curves = atol( argv[argi+1] );
+    else if ( !strcmp( argv[argi], "-d" ) )
+      max_digits = atoi( argv[argi+1] );
+    else
+      break;
+  }
+
+  if ( argi != argc - 1 ) {
+    printf( "\nUsage: ecm [-t threads] [-d max_digits] [-B1 b1 -c curves] n\n\n" );
+    return 1;
+  }
+
+  if ( threads < 1 )
+    threads = 1;
+
+  mpz_t n;
+  mpz_init_set_str( n, argv[argi], 10 );
+
+  if ( mpz_cmp_ui( n, 2 ) < 0 ) {
+    printf("\nThe number must be >= 2.  Aborting.\n\n");
+    mpz_clear(n);
+    return 1;
+  }
+
+  struct factor_infos Factor_Infos;
+  Init_Factor_Infos( &Factor_Infos );
+
+  if ( B1 > 0 )
+    ECM( n, B1, 100 * B1, 7, curves > 0 ? curves : 1, threads, &Factor_Infos );
+  else
+    ECMByDigits( n, max_digits, threads, &Factor_Infos );
+
+  Print_Factor_Infos( &Factor_Infos );
+
+  Cleanup_Factor_Infos( &Factor_Infos );
+  mpz_clear( n );
+
+  return 0;
+}
+#endif
+
+// Walk up the B1/curves table until a factor is found or max_digits is passed.
+// Returns 'F' if a factor was found, otherwise 'C', 'P' or 'N' for n itself.
+char ECMByDigits( mpz_t n, int max_digits, int threads, struct factor_infos* Factor_Infos ) {
+  if ( Factor_Infos == NULL )
+    return 'N';
+
+  char n_status = quickprimecheck( n );
+  if ( n_status != 'C' ) {
+    if ( n_status == 'P' )
+      AddFactorInfo( Factor_Infos, n, 1, 'P' );
+    return n_status;
+  }
+
+  unsigned long sigma = 7;
+  int level = 0;
+  for ( ; level < ecm_levels_count && ecm_levels[level].digits <= max_digits; level++ ) {
+    struct factor_infos Level_Infos;
+    Init_Factor_Infos( &Level_Infos );
+
+    char retval = ECM( n, ecm_levels[level].B1, 100 * ecm_levels[level].B1, sigma,
+                       ecm_levels[level].curves, threads, &Level_Infos );
+    sigma += ecm_levels[level].curves;
+
+    if ( retval == 'F' ) {
+      long i;
+      for ( i = 0; i < Level_Infos.count; i++ )
+        AddFactorInfo( Factor_Infos, Level_Infos.the_factors[i].the_factor,
+                       Level_Infos.the_factors[i].occurrences, Level_Infos.the_factors[i].factor_status );
+      Cleanup_Factor_Infos( &Level_Infos );
+      return 'F';
+    }
+    Cleanup_Factor_Infos( &Level_Infos );
+  }
+
+  AddFactorInfo( Factor_Infos, n, 1, 'C' );
+  return 'C';
+}
+
+// Run up to "curves" curves with sigma = first_sigma, first_sigma + 1, ...
+// On success, the factor found and its cofactor are added to Factor_Infos and
+// 'F' is returned.  Otherwise n is added as 'C' (or 'P') and 'C' (or 'P') is
+// returned.
+char ECM( mpz_t n, unsigned long B1, unsigned long B2, unsigned long first_sigma, long curves, int threads, struct factor_infos* Factor_Infos ) {
+  if ( Factor_Infos == NULL )
+    return 'N';
+
+  char n_status = quickprimecheck( n );
+  if ( n_status != 'C' ) {
+    if ( n_status == 'P' )
+      AddFactorInfo( Factor_Infos, n, 1, 'P' );
+    return n_status;
+  }
+
+  if ( B1 < 11 )
+    B1 = 11;
+  if ( B2 < B1 )
+    B2 = B1;
+
+  struct ecm_job job;
+  mpz_init_set( job.n, n );
+  mpz_init( job.factor );
+  job.B1 = B1;
+  job.B2 = B2;
+  job.first_sigma = first_sigma;
+  job.curves = curves;
+  job.next_curve = 0;
+  job.stop = 0;
+  pthread_mutex_init( &job.lock, NULL );
+
+  if ( threads > curves )
+    threads = (int) curves;
+  if ( threads < 1 )
+    threads = 1;
+
+  pthread_t* workers = (pthread_t*) calloc( threads, sizeof(pthread_t) );
+  int i;
+  for ( i = 0; i < threads; i++ )
+    pthread_create( &workers[i], NULL, ECM_Worker, &job );
+  for ( i = 0; i < threads; i++ )
+    pthread_join( workers[i], NULL );
+  free( workers );
+
+  char retval = 'C';
+  if ( mpz_cmp_ui( job.factor, 0 ) != 0 ) {
+    Add_Split( Factor_Infos, n, job.factor );
+    retval = 'F';
+  }
+  else
+    AddFactorInfo( Factor_Infos, n, 1, 'C' );
+
+  pthread_mutex_destroy( &job.lock );
+  mpz_clear( job.factor );
+  mpz_clear( job.n );
+
+  return retval;
+}
+
+static void* ECM_Worker( void* arg ) {
+  struct ecm_job* job = (struct ecm_job*) arg;
+
+  struct ecm_curve curve;
+  mpz_init_set( curve.n, job->n );
+  prime_iter_init( &curve.primes, 2 );
+  mpz_inits( curve.a24, curve.u, curve.v, curve.w, curve.t, curve.acc,
+             curve.R0.x, curve.R0.z, curve.R1.x, curve.R1.z, curve.Q.x, curve.Q.z,
+             curve.base.x, curve.base.z, NULL );
+
+  mpz_t g;
+  mpz_init( g );
+
+  while ( !job->stop ) {
+    pthread_mutex_lock( &job->lock );
+    long curve_number = job->next_curve++;
+    pthread_mutex_unlock( &job->lock );
+    if ( curve_number >= job->curves )
+      break;
+
+    if ( ECM_Curve( job, &curve, job->first_sigma + curve_number, g ) ) {
+      pthread_mutex_lock( &job->lock );
+      if ( !job->stop ) {
+        mpz_set( job->factor, g );
+        job->stop = 1;
+      }
+      pthread_mutex_unlock( &job->lock );
+    }
+  }
+
+  mpz_clear( g );
+  mpz_clears( curve.a24, curve.u, curve.v, curve.w, curve.t, curve.acc,
+              curve.R0.x, curve.R0.z, curve.R1.x, curve.R1.z, curve.Q.x, curve.Q.z,
+             curve.base.x, curve.base.z, NULL );
+  mpz_clear( curve.n );
+  prime_iter_clear( &curve.primes );
+
+  return NULL;
+}
+
+// Run one curve.  Returns 1 and sets g to a proper factor of n on success.
+static int ECM_Curve( struct ecm_job* job, struct ecm_curve* c, unsigned long sigma, mpz_t g ) {
+
+  // Suyama:  u = sigma^2 - 5,  v = 4.sigma,  x0 = u^3,  z0 = v^3
+  //          (A + 2) / 4 = (v - u)^3 . (3u + v) / (16 . u^3 . v)
+  mpz_set_ui( c->u, sigma );
+  mpz_mul( c->u, c->u, c->u );
+  mpz_sub_ui( c->u, c->u, 5 );
+  mpz_mod( c->u, c->u, c->n );
+  mpz_set_ui( c->v, sigma );
+  mpz_mul_2exp( c->v, c->v, 2 );
+  mpz_mod( c->v, c->v, c->n );
+
+  mpz_powm_ui( c->Q.x, c->u, 3, c->n );
+  mpz_powm_ui( c->Q.z, c->v, 3, c->n );
+
+  mpz_sub( c->w, c->v, c->u );
+  mpz_powm_ui( c->w, c->w, 3, c->n );
+  mpz_mul_ui( c->t, c->u, 3 );
+  mpz_add( c->t, c->t, c->v );
+  mpz_mul( c->a24, c->w, c->t );
+  mpz_mod( c->a24, c->a24, c->n );
+
+  mpz_mul( c->t, c->Q.x, c->v );
+  mpz_mul_2exp( c->t, c->t, 4 );
+  mpz_mod( c->t, c->t, c->n );
+  if ( !mpz_invert( c->w, c->t, c->n ) ) {
+    mpz_gcd( g, c->t, c->n );
+    return mpz_cmp_ui( g, 1 ) > 0 && mpz_cmp( g, c->n ) < 0;
+  }
+  mpz_mul( c->a24, c->a24, c->w );
+  mpz_mod( c->a24, c->a24, c->n );
+
+  // Stage 1.  Multiply Q by the largest power of each prime p <= B1.
+  // Stage 2's first window starts at D/2, so below that the primes
+  // B1 < p <= B2 are multiplied in here too, once each.
+  unsigned long p;
+  unsigned long count = 0;
+  unsigned long top = Stage1_Top( job );
+  prime_iter_skip_to( &c->primes, 2 );
+  for ( p = prime_iter_next( &c->primes ); p <= top; p = prime_iter_next( &c->primes ) ) {
+    unsigned long q = p;
+    while ( q <= job->B1 / p )
+      q *= p;
+    Ladder( c, &c->Q, &c->Q, q );
+
+    if ( (++count & 0xFF) == 0 && job->stop )
+      return 0;
+  }
+
+  mpz_gcd( g, c->Q.z, c->n );
+  if ( mpz_cmp_ui( g, 1 ) > 0 )
+    return mpz_cmp( g, c->n ) < 0;
+
+  if ( job->B2 <= top )
+    return 0;
+
+  return ECM_Stage2( job, c, g );
+}
+
+// The last prime stage 1 covers:  B1, or up to D/2 if B1 is below that
+static unsigned long Stage1_Top( struct ecm_job* job ) {
+  if ( job->B1 >= ECM_D / 2 )
+    return job->B1;
+  return job->B2 < ECM_D / 2 ? job->B2 : ECM_D / 2;
+}
+
+// Baby-step/giant-step stage 2.  Every prime B1 < p <= B2 is p = k.D +/- j
+// with j coprime to D and j < D/2.  Then p.Q == O (mod some prime factor)
+// exactly when x(k.D.Q) == x(j.Q), so we accumulate the product of
+// X(kDQ).Z(jQ) - X(jQ).Z(kDQ) and take one gcd at the end.
+static int ECM_Stage2( struct ecm_job* job, struct ecm_curve* c, mpz_t g ) {
+
+  int retval = 0;
+  int j;
+
+  // Baby steps:  j.Q for odd j < D/2, normalized so z == 1 for those coprime to D.
+  struct ecm_point* baby = (struct ecm_point*) calloc( ECM_D / 2, sizeof(struct ecm_point) );
+  for ( j = 0; j < ECM_D / 2; j++ )
+    mpz_inits( baby[j].x, baby[j].z, NULL );
+
+  struct ecm_point two_Q;
+  mpz_inits( two_Q.x, two_Q.z, NULL );
+  xDBL( c, &two_Q, &c->Q );
+
+  mpz_set( baby[1].x, c->Q.x );
+  mpz_set( baby[1].z, c->Q.z );
+  xADD( c, &baby[3], &two_Q, &baby[1], &baby[1] );
+  for ( j = 5; j < ECM_D / 2; j += 2 )
+    xADD( c, &baby[j], &baby[j-2], &two_Q, &baby[j-4] );
+
+  mpz_set_ui( c->acc, 1 );
+  for ( j = 1; j < ECM_D / 2; j += 2 ) {
+    if ( j % 3 == 0 || j % 5 == 0 || j % 7 == 0 || j % 11 == 0 )
+      continue;
+    if ( !mpz_invert( c->w, baby[j].z, c->n ) ) {
+      mpz_gcd( g, baby[j].z, c->n );
+      retval = mpz_cmp_ui( g, 1 ) > 0 && mpz_cmp( g, c->n ) < 0;
+      goto cleanup;
+    }
+    mpz_mul( baby[j].x, baby[j].x, c->w );
+    mpz_mod( baby[j].x, baby[j].x, c->n );
+    mpz_set_ui( baby[j].z, 1 );
+  }
+
+  // Giant steps:  G_k = k.D.Q, stepping with G_{k+1} = G_k + D.Q (difference G_{k-1}).
+  // Window k = 0 would need 0.Q, so stage 1 has done the primes below D/2.
+  unsigned long k = (job->B1 + ECM_D / 2) / ECM_D;
+  if ( k < 1 )
+    k = 1;
+  unsigned long k_max = (job->B2 + ECM_D / 2) / ECM_D;
+
+  struct ecm_point DQ, G_prev, G, G_next;
+  mpz_inits( DQ.x, DQ.z, G_prev.x, G_prev.z, G.x, G.z, G_next.x, G_next.z, NULL );
+  Ladder( c, &DQ, &c->Q, ECM_D );
+  Ladder( c, &G_prev, &c->Q, k * ECM_D );
+  Ladder( c, &G, &c->Q, (k + 1) * ECM_D );
+
+  // The windows k.D - D/2 .. k.D + D/2 follow on from each other, so the
+  // primes come straight off the iterator.  use[j] marks k.D +/- j prime.
+  uint8_t use[ECM_D / 2];
+  prime_iter_skip_to( &c->primes, Stage1_Top( job ) + 1 );
+  unsigned long p = prime_iter_next( &c->primes );
+
+  for ( ; k <= k_max && !job->stop; k++ ) {
+    // G_prev is k.D.Q here
+    unsigned long center = k * ECM_D;
+    memset( use, 0, sizeof(use) );
+    for ( ; p < center + ECM_D / 2 && p <= job->B2; p = prime_iter_next( &c->primes ) )
+      if ( p > center - ECM_D / 2 )
+        use[p > center ? p - center : center - p] = 1;
+
+    for ( j = 1; j < ECM_D / 2; j += 2 ) {
+      if ( mpz_cmp_ui( baby[j].z, 1 ) != 0 || !use[j] )
+        continue;
+
+      mpz_mul( c->t, baby[j].x, G_prev.z );
+      mpz_sub( c->t, G_prev.x, c->t );
+      mpz_mul( c->acc, c->acc, c->t );
+      mpz_mod( c->acc, c->acc, c->n );
+    }
+
+    xADD( c, &G_next, &G, &DQ, &G_prev );
+    mpz_swap( G_prev.x, G.x );
+    mpz_swap( G_prev.z, G.z );
+    mpz_swap( G.x, G_next.x );
+    mpz_swap( G.z, G_next.z );
+  }
+
+  mpz_gcd( g, c->acc, c->n );
+  retval = mpz_cmp_ui( g, 1 ) > 0 && mpz_cmp( g, c->n ) < 0;
+
+  mpz_clears( DQ.x, DQ.z, G_prev.x, G_prev.z, G.x, G.z, G_next.x, G_next.z, NULL );
+
+cleanup:
+  mpz_clears( two_Q.x, two_Q.z, NULL );
+  for ( j = 0; j < ECM_D / 2; j++ )
+    mpz_clears( baby[j].x, baby[j].z, NULL );
+  free( baby );
+
+  return retval;
+}
+
+// R = 2P
+//   X2 = (X + Z)^2 . (X - Z)^2
+//   Z2 = 4XZ . ((X - Z)^2 + a24 . 4XZ)
+static void xDBL( struct ecm_curve* c, struct ecm_point* R, struct ecm_point* P ) {
+  mpz_add( c->u, P->x, P->z );
+  mpz_mul( c->u, c->u, c->u );
+  mpz_sub( c->v, P->x, P->z );
+  mpz_mul( c->v, c->v, c->v );
+  mpz_sub( c->t, c->u, c->v );        // 4XZ
+  mpz_mul( R->x, c->u, c->v );
+  mpz_mod( R->x, R->x, c->n );
+  mpz_mul( c->w, c->a24, c->t );
+  mpz_add( c->w, c->w, c->v );
+  mpz_mul( R->z, c->t, c->w );
+  mpz_mod( R->z, R->z, c->n );
+}
+
+// R = P + Q given D = P - Q.  R may be the same point as P or Q, but not D.
+//   X = Zd . ((Xp - Zp)(Xq + Zq) + (Xp + Zp)(Xq - Zq))^2
+//   Z = Xd . ((Xp - Zp)(Xq + Zq) - (Xp + Zp)(Xq - Zq))^2
+static void xADD( struct ecm_curve* c, struct ecm_point* R, struct ecm_point* P, struct ecm_point* Q, struct ecm_point* D ) {
+  mpz_sub( c->u, P->x, P->z );
+  mpz_add( c->t, Q->x, Q->z );
+  mpz_mul( c->u, c->u, c->t );
+  mpz_add( c->v, P->x, P->z );
+  mpz_sub( c->t, Q->x, Q->z );
+  mpz_mul( c->v, c->v, c->t );
+
+  mpz_add( c->w, c->u, c->v );
+  mpz_mul( c->w, c->w, c->w );
+  mpz_sub( c->t, c->u, c->v );
+  mpz_mul( c->t, c->t, c->t );
+
+  mpz_mul( R->x, c->w, D->z );
+  mpz_mod( R->x, R->x, c->n );
+  mpz_mul( R->z, c->t, D->x );
+  mpz_mod( R->z, R->z, c->n );
+}
+
+// R = m.P with the Montgomery ladder.  R may be the same point as P.
+static void Ladder( struct ecm_curve* c, struct ecm_point* R, struct ecm_point* P, unsigned long m ) {
+  if ( m == 1 ) {
+    mpz_set( R->x, P->x );
+    mpz_set( R->z, P->z );
+    return;
+  }
+
+  struct ecm_point* base = &c->base;
+  mpz_set( base->x, P->x );
+  mpz_set( base->z, P->z );
+
+  // invariant: R1 - R0 == base
+  mpz_set( c->R0.x, base->x );
+  mpz_set( c->R0.z, base->z );
+  xDBL( c, &c->R1, base );
+
+  int bit = 62;
+  while ( !((m >> bit) & 1) )
+    bit--;
+
+  for ( bit--; bit >= 0; bit-- ) {
+    if ( (m >> bit) & 1 ) {
+      xADD( c, &c->R0, &c->R0, &c->R1, base );
+      xDBL( c, &c->R1, &c->R1 );
+    }
+    else {
+      xADD( c, &c->R1, &c->R0, &c->R1, base );
+      xDBL( c, &c->R0, &c->R0 );
+    }
+  }
+
+  mpz_set( R->x, c->R0.x );
+  mpz_set( R->z, c->R0.z );
+}
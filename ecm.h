@@ -0,0 +1,14 @@
+/* Public Domain.  See the LICENSE file.                                     */
+
+/* Elliptic Curve Method, see ecm.c                                          */
+
+#ifndef ECM_H
+#define ECM_H
+
+#include <gmp.h>
+#include "factor_infos.h"
+
+char ECM( mpz_t, unsigned long, unsigned long, unsigned long, long, int, struct factor_infos* );
+char ECMByDigits( mpz_t, int, int, struct factor_infos* );
+
+#endif
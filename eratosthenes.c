@@ -5,15 +5,28 @@
 /* https://wikipedia.org/wiki/Sieve_of_Eratosthenes                 */
 /* https://t5k.org/howmany.html#table (For prime counts)            */
 
-/* No dependencies.                                                 */
-/* On linux, try:  cc eratosthenes.c -o eratosthenes                */
+/* The bitmap comes from big_alloc.c:  on 2 MiB pages where the     */
+/* machine allows it (-p), and spread over NUMA nodes as asked      */
+/* (-n).  Large primes cross off a new cache line (and with 4 KiB   */
+/* pages, a new page) at every step, so the marking loop prefetches */
+/* PREFETCH_STRIDES steps ahead.                                    */
+
+/* On linux, try:                                                   */
+/*   cc -O2 eratosthenes.c stats.c big_alloc.c -o eratosthenes      */
+/* --stats (or --stats=json) reports the work done, see stats.c.    */
 
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include <time.h>
 
+#include "stats.h"
+#include "big_alloc.h"
+
+#define PREFETCH_STRIDES 16    // how many strides ahead the marking loop prefetches
+
 unsigned int  mask[32] = {0x00000001,0x00000002,0x00000004,0x00000008,
                           0x00000010,0x00000020,0x00000040,0x00000080,
                           0x00000100,0x00000200,0x00000400,0x00000800,
@@ -28,12 +41,19 @@ int64_t isqrt( int64_t number );
 
 int main( int argc, char * argv[] ) {
 
+  struct stats stats;
+  Stats_Init( &stats, &argc, argv );
+
   printf( "\n" );
   printf( "         Sieve Of Eratosthenes\n" );
   printf( "\n" );
   printf( "\n" );
   printf( "\n" );
-  printf( "Usage: eratosthenes limit\n" );
+  printf( "Usage: eratosthenes [-p auto|hugetlb|thp|small] [-n default|interleave|local] [--stats[=json]] limit\n" );
+  printf( "\n" );
+  printf( "  -p   pages for the bitmap (default auto).  auto and hugetlb: hugetlb, else THP, else small,\n" );
+  printf( "       but auto takes small pages for a bitmap under 2 MiB.  thp: THP, else small\n" );
+  printf( "  -n   NUMA placement of the bitmap (default: the system's policy)\n" );
   printf( "\n" );
   printf( "\n" );
   printf( "NOTE: Memory usage in bytes will be limit / 8.\n" );
@@ -42,18 +62,44 @@ int main( int argc, char * argv[] ) {
   printf( "\n" );
   printf( "\n" );
 
-  if ( argc != 2 ) {
-    fprintf( stderr, "Usage: eratosthenes limit\n");
+  enum big_pages pages = BIG_PAGES_AUTO;
+  enum big_numa numa = BIG_NUMA_DEFAULT;
+  const char* page_names[4] = { "auto", "hugetlb", "thp", "small" };
+  const char* numa_names[3] = { "default", "interleave", "local" };
+
+  int argi = 1, k, ok = 1;
+  while ( ok && argi < argc - 1 ) {
+    ok = 0;
+    if ( !strcmp( argv[argi], "-p" ) )
+      for ( k = 0; k < 4; k++ )
+        if ( !strcmp( argv[argi + 1], page_names[k] ) ) {
+          pages = (enum big_pages) k;
+          ok = 1;
+        }
+    if ( !strcmp( argv[argi], "-n" ) )
+      for ( k = 0; k < 3; k++ )
+        if ( !strcmp( argv[argi + 1], numa_names[k] ) ) {
+          numa = (enum big_numa) k;
+          ok = 1;
+        }
+    if ( ok )
+      argi += 2;
+  }
+
+  if ( !ok || argi != argc - 1 ) {
+    fprintf( stderr, "Usage: eratosthenes [-p auto|hugetlb|thp|small] [-n default|interleave|local] [--stats[=json]] limit\n");
     return 1;
   }
 
-  int64_t limit = atol( argv[1] );
+  int64_t limit = atol( argv[argi] );
   int64_t max_limit = 1000000000000000000L;
   if ( limit < 2 || limit > max_limit  ) {
     fprintf( stderr, "Error: limit must >= 2 and <= %ld. Aborting.\n\n", max_limit );
     return 1;
   }
 
+  Stats_Phase_Start( &stats, "allocate" );
+
   struct timespec  time_t0;
   clock_gettime(CLOCK_REALTIME, &time_t0);
 
@@ -66,15 +112,23 @@ int main( int argc, char * argv[] ) {
   // after all primes are computed, a bit set to 1 will represent a non-prime
   // and a bit set to 0 will represent a prime
 
-  uint32_t* array = (uint32_t *) calloc( limit / 32 + 1, sizeof(uint32_t) );
-  if ( array == NULL ) {
+  struct big_block block;
+  if ( !Big_Alloc( &block, (limit / 32 + 1) * sizeof(uint32_t), pages, numa ) ) {
     fprintf( stderr, "Error: Failed to allocate memory. Aborting.\n\n" );
     return 1;
   }
+  uint32_t* array = (uint32_t *) block.ptr;
 
   struct timespec  time_t1;
   clock_gettime(CLOCK_REALTIME, &time_t1);
 
+  Stats_Phase_Stop( &stats );
+  Stats_Count( &stats, "bytes", (limit / 32 + 1) * sizeof(uint32_t) );
+  Stats_Count( &stats, "huge pages", block.pages == BIG_PAGES_SMALL ? 0 : 1 );
+  Stats_Phase_Start( &stats, "compute primes" );
+  uint64_t sieving_primes = 0;
+  uint64_t writes = 0;
+
   array[0] |= mask[0]; // corresponds to the number 0 which is not prime
   array[0] |= mask[1]; // corresponds to the number 1 which is not prime
 
@@ -87,17 +141,37 @@ int main( int argc, char * argv[] ) {
     quot = i >> 5;  // dividing by 2^5 which is 32
     rem = i & 0x0000001F; // last 5 bits are the remainder after dividing by 32
     if (!(mask[rem] & array[quot])) {
-      for (j = i+i; j <= limit; j += i) {
+      j = i+i;
+      // from 512 up every stride lands on a new cache line, so ask for the
+      // line PREFETCH_STRIDES strides ahead while marking this one
+      if ( i >= 512 ) {
+        int64_t ahead = PREFETCH_STRIDES * i;
+        for (; j + ahead <= limit; j += i) {
+          __builtin_prefetch( &array[(j + ahead) >> 5], 1, 0 );
+          array[j >> 5] |= mask[j & 0x1F];
+        }
+      }
+      for (; j <= limit; j += i) {
         quot = j >> 5; // dividing by 2^5 which is 32
         rem = j & 0x0000001F; // last 5 bits are the remainder after dividing by 32
         array[quot] |= mask[rem];
       }
+      if ( stats.enabled ) {
+        sieving_primes++;
+        if ( i + i <= limit )
+          writes += (limit - i - i) / i + 1;
+      }
     }
   }
 
   struct timespec  time_t2;
   clock_gettime(CLOCK_REALTIME, &time_t2);
 
+  Stats_Phase_Stop( &stats );
+  Stats_Count( &stats, "segments", 1 );
+  Stats_Count( &stats, "sieving primes", sieving_primes );
+  Stats_Count( &stats, "crossing-off writes", writes );
+
   intmax_t elapsed_secs = time_t1.tv_sec - time_t0.tv_sec;
   intmax_t elapsed_nsecs = time_t1.tv_nsec - time_t0.tv_nsec;
 
@@ -105,6 +179,10 @@ int main( int argc, char * argv[] ) {
     elapsed_nsecs += 1000000000;
     --elapsed_secs;
   }
+  char description[256];
+  Big_Describe( &block, description, sizeof(description) );
+  printf( "\n" );
+  printf( "Bitmap: %s\n", description );
   printf( "\n" );
   printf( "Time To allocate memory (secs):   %jd.%09jd\n", elapsed_secs, elapsed_nsecs );
 
@@ -119,6 +197,8 @@ int main( int argc, char * argv[] ) {
   printf( "\n" );
   printf( "Time To compute primes  (secs):   %jd.%09jd\n", elapsed_secs, elapsed_nsecs );
 
+  Stats_Phase_Start( &stats, "count primes" );
+
   int64_t count = 0;
   for (i = 0; i <= limit; i++) {
     quot = i >> 5; // dividing by 2^5 which is 32
@@ -130,6 +210,9 @@ int main( int argc, char * argv[] ) {
   struct timespec  time_t3;
   clock_gettime(CLOCK_REALTIME, &time_t3);
 
+  Stats_Phase_Stop( &stats );
+  Stats_Count( &stats, "numbers scanned", limit + 1 );
+
   printf( "\n" );
   printf( "Total number of primes generated: %ld\n", count );
 
@@ -147,10 +230,11 @@ int main( int argc, char * argv[] ) {
 
   printf( "\n" );
 
-  if ( array != NULL ) {
-    free( array );
-    array = NULL;
-  }
+  Stats_Print( &stats, stderr );
+  Stats_Cleanup( &stats );
+
+  Big_Free( &block );
+  array = NULL;
 
   return 0;
 }
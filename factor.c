@@ -0,0 +1,367 @@
+/* Public Domain.  See the LICENSE file.                                     */
+
+/* A tiered factoring driver.  N goes through trial division first, then     */
+/* each composite cofactor left on the work queue goes to the cheapest tier  */
+/* that suits its size:                                                      */
+/*                                                                           */
+/*   - up to SMALL_N_BITS bits:  Brent's rho on native 64 bit words          */
+/*   - otherwise:                a short run of rho.c's Rho()                */
+/*                               then ECM (ecm.c) up to a depth set by size  */
+/*                               then SIQS (siqs.c) for 40-100 digits        */
+/*                                                                           */
+/* Every piece found goes back on the queue until it is marked 'P', or 'C'   */
+/* if every tier gave up on it, the same way quickprimecheck() does.  The    */
+/* time spent in each tier is reported after the factorization.  With -c     */
+/* each prime factor is also proven, see Prime_Certify() in primality.c.     */
+/*                                                                           */
+/* The trial division bound, the rho run and the SIQS crossover can be set   */
+/* for the machine by its profile (factor.tf_limit, factor.rho_iterations,   */
+/* factor.siqs_min_bits, see profile.c and tune.c).                          */
+
+/* To compile, the GMP library needs to be already installed.                */
+/* See https://gmplib.org                                                    */
+/* On linux, try:                                                            */
+/*   cc -O2 -DFACTOR_NO_MAIN factor.c factor_infos.c primality.c WheelTF.c   */
+/*      rho.c ecm.c siqs.c prime_iter.c profile.c -lgmp -lm -lpthread        */
+/*      -o factor                                                            */
+
+/* Some test numbers:                                                        */
+/* factor 1000000016000000063          --> 1000000007.1000000009             */
+/* factor 2535301200456458802993406410751                                    */
+/*                                     --> 7432339208719.341117531003194129  */
+/* factor 61748077010482815902444783236944717198361852023577                 */
+/*              --> 6263457312334903264362547.9858465370056821370479491      */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <gmp.h>
+
+#include "factor_infos.h"
+#include "primality.h"
+#include "WheelTF.h"
+#include "rho.h"
+#include "ecm.h"
+#include "siqs.h"
+#include "profile.h"
+
+// Tier thresholds, by bit size of the composite being worked on
+#define TF_LIMIT          65536ul   // trial division bound
+#define SMALL_N_BITS      64        // native rho at or below this
+#define RHO_ITERATIONS    20000     // short mpz rho run before ECM
+#define SIQS_MIN_BITS     130       // ~40 digits.  Below this ECM only
+#define SIQS_MAX_BITS     332       // ~100 digits.  Above this ECM only
+#define ECM_MAX_DIGITS    45        // deepest ECM level when SIQS is not used
+
+// The profile's values, or the defaults above
+unsigned long tf_limit   = TF_LIMIT;
+long rho_iterations      = RHO_ITERATIONS;
+size_t siqs_min_bits     = SIQS_MIN_BITS;
+
+enum tier { TIER_TF, TIER_SMALL_N, TIER_RHO, TIER_ECM, TIER_SIQS, TIER_COUNT };
+
+const char* tier_names[TIER_COUNT] = { "trial division", "small N rho", "rho", "ecm", "siqs" };
+
+struct tier_stats {
+double          seconds[TIER_COUNT];
+long            calls[TIER_COUNT];
+struct timespec started;
+};
+
+void Factor( mpz_t, int, struct factor_infos*, struct tier_stats* );
+void Queue_Pieces( struct factor_infos*, struct factor_infos*, long );
+int Split_Composite( mpz_t, int, struct factor_infos*, struct tier_stats* );
+int Perfect_Power( mpz_t, mpz_t );
+uint64_t Rho64( uint64_t );
+uint64_t mulmod64( uint64_t, uint64_t, uint64_t );
+uint64_t sqraddmod64( uint64_t, uint64_t, uint64_t );
+uint64_t gcd64( uint64_t, uint64_t );
+void Tier_Start( struct tier_stats* );
+void Tier_Stop( struct tier_stats*, enum tier );
+
+int main( int argc, char * argv[] ) {
+
+  int threads = (int) sysconf( _SC_NPROCESSORS_ONLN );
+
+  int certify = 0;
+
+  tf_limit       = (unsigned long) Profile_Get( "factor.tf_limit", TF_LIMIT );
+  rho_iterations = Profile_Get( "factor.rho_iterations", RHO_ITERATIONS );
+  siqs_min_bits  = (size_t) Profile_Get( "factor.siqs_min_bits", SIQS_MIN_BITS );
+
+  int argi = 1;
+  for ( ; argi < argc - 1; argi++ ) {
+    if ( !strcmp( argv[argi], "-t" ) && argi + 1 < argc - 1 )
+      threads = atoi( argv[++argi] );
+    else if ( !strcmp( argv[argi], "-c" ) )
+      certify = 1;
+    else
+      break;
+  }
+
+  if ( argi != argc - 1 ) {
+    printf( "\nUsage: factor [-t threads] [-c] n\n\n" );
+    printf( "  -c   prove each prime factor and print the certificates\n\n" );
+    return 1;
+  }
+
+  if ( threads < 1 )
+    threads = 1;
+
+  mpz_t n;
+  mpz_init_set_str( n, argv[argi], 10 );
+
+  if ( mpz_cmp_ui( n, 2 ) < 0 ) {
+    printf("\nThe number must be >= 2.  Aborting.\n\n");
+    mpz_clear(n);
+    return 1;
+  }
+
+  struct factor_infos Factor_Infos;
+  Init_Factor_Infos( &Factor_Infos );
+
+  struct tier_stats stats;
+  memset( &stats, 0, sizeof(stats) );
+
+  Factor( n, threads, &Factor_Infos, &stats );
+
+  Print_Factor_Infos( &Factor_Infos );
+
+  if ( certify ) {
+    printf( "\n" );
+    long i;
+    for ( i = 0; i < Factor_Infos.count; i++ ) {
+      if ( Factor_Infos.the_factors[i].factor_status != 'P' )
+        continue;
+      if ( Prime_Certify( Factor_Infos.the_factors[i].the_factor, stdout ) != 1 )
+        gmp_printf( "%Zd : probable prime, no certificate found\n", Factor_Infos.the_factors[i].the_factor );
+    }
+  }
+
+  printf( "\n" );
+  int t;
+  for ( t = 0; t < TIER_COUNT; t++ )
+    if ( stats.calls[t] > 0 )
+      printf( "Time in %-15s (secs):   %.9f   (%ld call%s)\n", tier_names[t], stats.seconds[t],
+              stats.calls[t], stats.calls[t] == 1 ? "" : "s" );
+  printf( "\n" );
+
+  Cleanup_Factor_Infos( &Factor_Infos );
+  mpz_clear( n );
+
+  return 0;
+}
+
+// Completely factor n into Factor_Infos, sorted with equal factors merged.
+void Factor( mpz_t n, int threads, struct factor_infos* Factor_Infos, struct tier_stats* stats ) {
+  if ( Factor_Infos == NULL )
+    return;
+
+  struct factor_infos queue;
+  Init_Factor_Infos( &queue );
+
+  Tier_Start( stats );
+  WheelTFLimit( n, tf_limit, &queue );
+  Tier_Stop( stats, TIER_TF );
+
+  mpz_t m;
+  mpz_init( m );
+
+  // The queue only ever grows.  Entries before i are done with.
+  long i;
+  for ( i = 0; i < queue.count; i++ ) {
+    mpz_set( m, queue.the_factors[i].the_factor );
+    long occurrences = queue.the_factors[i].occurrences;
+    char status = queue.the_factors[i].factor_status;
+
+    if ( status == 'N' )
+      continue;
+
+    if ( status == 'P' ) {
+      AddFactorInfo( Factor_Infos, m, occurrences, 'P' );
+      continue;
+    }
+
+    struct factor_infos pieces;
+    Init_Factor_Infos( &pieces );
+
+    if ( Split_Composite( m, threads, &pieces, stats ) )
+      Queue_Pieces( &queue, &pieces, occurrences );
+    else
+      AddFactorInfo( Factor_Infos, m, occurrences, 'C' );
+
+    Cleanup_Factor_Infos( &pieces );
+  }
+
+  Sort_Factor_Infos( Factor_Infos );
+
+  mpz_clear( m );
+  Cleanup_Factor_Infos( &queue );
+}
+
+// Append pieces to the queue, each raised to the parent's multiplicity
+void Queue_Pieces( struct factor_infos* queue, struct factor_infos* pieces, long occurrences ) {
+  long i;
+  for ( i = 0; i < pieces->count; i++ )
+    AddFactorInfo( queue, pieces->the_factors[i].the_factor,
+                   pieces->the_factors[i].occurrences * occurrences, pieces->the_factors[i].factor_status );
+}
+
+// Pick a tier by the size of m and try to split it.  Returns 1 with the
+// pieces in Pieces, or 0 if every tier gave up.
+int Split_Composite( mpz_t m, int threads, struct factor_infos* Pieces, struct tier_stats* stats ) {
+
+  mpz_t d;
+  mpz_init( d );
+  int found = 0;
+
+  // m = r^e is handled as e copies of r
+  int e = Perfect_Power( m, d );
+  if ( e > 1 ) {
+    AddFactorInfo( Pieces, d, e, quickprimecheck( d ) );
+    mpz_clear( d );
+    return 1;
+  }
+
+  size_t bits = mpz_sizeinbase( m, 2 );
+
+  if ( bits <= SMALL_N_BITS ) {
+    Tier_Start( stats );
+    uint64_t factor = Rho64( (uint64_t) mpz_get_ui( m ) );
+    Tier_Stop( stats, TIER_SMALL_N );
+    if ( factor != 0 ) {
+      mpz_set_ui( d, factor );
+      Add_Split( Pieces, m, d );
+      found = 1;
+    }
+    mpz_clear( d );
+    return found;
+  }
+
+  Tier_Start( stats );
+  found = rho_iterations > 0 && Rho( m, 1, rho_iterations, d );
+  Tier_Stop( stats, TIER_RHO );
+  if ( found ) {
+    Add_Split( Pieces, m, d );
+    mpz_clear( d );
+    return 1;
+  }
+  mpz_clear( d );
+
+  // With SIQS to fall back on, only run ECM deep enough to catch factors
+  // that are small relative to m.
+  int use_siqs = bits >= siqs_min_bits && bits <= SIQS_MAX_BITS;
+  int ecm_digits = use_siqs ? (int) (bits * 0.30103 / 3) : ECM_MAX_DIGITS;
+
+  if ( ecm_digits >= 15 ) {
+    Tier_Start( stats );
+    char retval = ECMByDigits( m, ecm_digits, threads, Pieces );
+    Tier_Stop( stats, TIER_ECM );
+    if ( retval == 'F' )
+      return 1;
+    Cleanup_Factor_Infos( Pieces );
+  }
+
+  if ( use_siqs ) {
+    Tier_Start( stats );
+    char retval = SIQS( m, threads, Pieces );
+    Tier_Stop( stats, TIER_SIQS );
+    if ( retval == 'F' )
+      return 1;
+    Cleanup_Factor_Infos( Pieces );
+  }
+
+  return 0;
+}
+
+// Returns the largest e with m = r^e, setting r.  Returns 1 if m is not a
+// perfect power.
+int Perfect_Power( mpz_t m, mpz_t r ) {
+  if ( !mpz_perfect_power_p( m ) )
+    return 1;
+
+  unsigned long e;
+  for ( e = mpz_sizeinbase( m, 2 ); e >= 2; e-- )
+    if ( mpz_root( r, m, e ) )
+      return (int) e;
+
+  return 1;
+}
+
+// Brent's variant of Pollard's rho on 64 bit words, multiplying 128 |x - y|
+// values together between gcds.  Returns a non-trivial factor, or 0.
+uint64_t Rho64( uint64_t n ) {
+  if ( (n & 1) == 0 )
+    return 2;
+
+  uint64_t c;
+  for ( c = 1; c < 64; c++ ) {
+    uint64_t y = 2, x = 2, ys = 2, q = 1, g = 1;
+    uint64_t r = 1, k, i;
+
+    while ( g == 1 ) {
+      x = y;
+      for ( i = 0; i < r; i++ )
+        y = sqraddmod64( y, c, n );
+
+      for ( k = 0; k < r && g == 1; k += 128 ) {
+        ys = y;
+        uint64_t limit = r - k < 128 ? r - k : 128;
+        for ( i = 0; i < limit; i++ ) {
+          y = sqraddmod64( y, c, n );
+          q = mulmod64( q, x > y ? x - y : y - x, n );
+        }
+        g = gcd64( q, n );
+      }
+      r <<= 1;
+    }
+
+    // the batch overshot, step back one at a time
+    if ( g == n ) {
+      do {
+        ys = sqraddmod64( ys, c, n );
+        g = gcd64( x > ys ? x - ys : ys - x, n );
+      } while ( g == 1 );
+    }
+
+    if ( g != n )
+      return g;
+  }
+
+  return 0;
+}
+
+uint64_t mulmod64( uint64_t a, uint64_t b, uint64_t n ) {
+  return (uint64_t) ((unsigned __int128) a * b % n);
+}
+
+// y^2 + c (mod n).  n can be close to 2^64, so the add must not wrap.
+uint64_t sqraddmod64( uint64_t y, uint64_t c, uint64_t n ) {
+  uint64_t r = mulmod64( y, y, n );
+  c %= n;
+  return r >= n - c ? r - (n - c) : r + c;
+}
+
+uint64_t gcd64( uint64_t a, uint64_t b ) {
+  while ( b != 0 ) {
+    uint64_t t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+void Tier_Start( struct tier_stats* stats ) {
+  clock_gettime( CLOCK_MONOTONIC, &stats->started );
+}
+
+void Tier_Stop( struct tier_stats* stats, enum tier t ) {
+  struct timespec now;
+  clock_gettime( CLOCK_MONOTONIC, &now );
+  stats->seconds[t] += (now.tv_sec - stats->started.tv_sec) + (now.tv_nsec - stats->started.tv_nsec) / 1e9;
+  stats->calls[t]++;
+}
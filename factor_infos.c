@@ -0,0 +1,189 @@
+/* Public Domain.  See the LICENSE file.                                     */
+
+/* Helpers for struct factor_infos.  Linked into WheelTF, ecm, etc. along    */
+/* with primality.c.                                                         */
+
+/* To compile, the GMP library needs to be already installed.                */
+/* See https://gmplib.org                                                    */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gmp.h>
+
+#include "factor_infos.h"
+#include "primality.h"
+
+// Returns number type.  'C' --> Composite, 'P' --> Prime (very probably), 'N' --> Neither (ie. the number 1)
+char quickprimecheck( mpz_t the_number ) {
+  return Prime_Status( the_number );
+}
+
+// Compute the number of times denominator divides evenly into numerator
+long ComputeOccurrences( mpz_t numerator, mpz_t denominator ) {
+
+  // not handled values
+  if ( mpz_cmp_ui( denominator, 1 ) <= 0 )
+    return -1;
+
+  if ( !mpz_divisible_p( numerator, denominator ) )
+    return 0;
+
+  mpz_t quotient;
+  mpz_init( quotient );
+  long occurrences = (long) mpz_remove( quotient, numerator, denominator );
+  mpz_clear( quotient );
+
+  return occurrences;
+}
+
+// Initialize factor_infos
+void Init_Factor_Infos( struct factor_infos* Factor_Infos ) {
+  if ( Factor_Infos == NULL )
+    return;
+  Factor_Infos->count = 0;
+  Factor_Infos->capacity = 0;
+  Factor_Infos->the_factors = NULL;
+}
+
+// Make room for at least capacity factors.  Slots are initialized once here
+// and kept, limbs and all, until Cleanup_Factor_Infos().
+void Reserve_Factor_Infos( struct factor_infos* Factor_Infos, long capacity ) {
+  if ( Factor_Infos == NULL || capacity <= Factor_Infos->capacity )
+    return;
+
+  Factor_Infos->the_factors = (struct factor_info*) realloc( Factor_Infos->the_factors, sizeof(struct factor_info) * capacity );
+
+  long i;
+  for ( i = Factor_Infos->capacity; i < capacity; i++ ) {
+    memset( &Factor_Infos->the_factors[i], 0, sizeof(struct factor_info) );
+    mpz_init( Factor_Infos->the_factors[i].the_factor );
+  }
+  Factor_Infos->capacity = capacity;
+}
+
+// Empty the list but keep its slots for reuse
+void Reset_Factor_Infos( struct factor_infos* Factor_Infos ) {
+  if ( Factor_Infos == NULL )
+    return;
+  Factor_Infos->count = 0;
+}
+
+// Next free slot, doubling the reserved capacity when full
+static struct factor_info* New_Factor_Slot( struct factor_infos* Factor_Infos ) {
+  if ( Factor_Infos->count == Factor_Infos->capacity )
+    Reserve_Factor_Infos( Factor_Infos, Factor_Infos->capacity < FACTOR_INFOS_MIN_CAPACITY ?
+                                        FACTOR_INFOS_MIN_CAPACITY : 2 * Factor_Infos->capacity );
+  return &Factor_Infos->the_factors[Factor_Infos->count++];
+}
+
+// Add a factor to factor_infos structure
+void AddFactorInfo( struct factor_infos* Factor_Infos, mpz_t the_factor, long occurrences, char factor_status ) {
+  struct factor_info* slot = New_Factor_Slot( Factor_Infos );
+  mpz_set( slot->the_factor, the_factor );
+  slot->occurrences    = occurrences;
+  slot->factor_status  = factor_status;
+}
+
+// Same as AddFactorInfo() for a factor that fits in an unsigned long
+void AddFactorInfoUI( struct factor_infos* Factor_Infos, unsigned long the_factor, long occurrences, char factor_status ) {
+  struct factor_info* slot = New_Factor_Slot( Factor_Infos );
+  mpz_set_ui( slot->the_factor, the_factor );
+  slot->occurrences    = occurrences;
+  slot->factor_status  = factor_status;
+}
+
+// Add n split by the non-trivial divisor d, smallest first.  d is overwritten.
+void Add_Split( struct factor_infos* Factor_Infos, mpz_t n, mpz_t d ) {
+  mpz_t cofactor;
+  mpz_init( cofactor );
+  Add_Split_Scratch( Factor_Infos, n, d, cofactor );
+  mpz_clear( cofactor );
+}
+
+// Add_Split() with the caller's temporary
+void Add_Split_Scratch( struct factor_infos* Factor_Infos, mpz_t n, mpz_t d, mpz_t cofactor ) {
+  mpz_divexact( cofactor, n, d );
+
+  if ( mpz_cmp( d, cofactor ) > 0 )
+    mpz_swap( d, cofactor );
+
+  // d may divide n more than once
+  long occurrences = 1;
+  while ( mpz_divisible_p( cofactor, d ) ) {
+    mpz_divexact( cofactor, cofactor, d );
+    occurrences++;
+  }
+
+  AddFactorInfo( Factor_Infos, d, occurrences, quickprimecheck( d ) );
+  if ( mpz_cmp_ui( cofactor, 1 ) != 0 )
+    AddFactorInfo( Factor_Infos, cofactor, 1, quickprimecheck( cofactor ) );
+}
+
+// Sort ascending by factor and merge equal factors into one entry
+void Sort_Factor_Infos( struct factor_infos* Factor_Infos ) {
+  if ( Factor_Infos == NULL )
+    return;
+
+  struct factor_info* the_factors = Factor_Infos->the_factors;
+  long i, j;
+  for ( i = 1; i < Factor_Infos->count; i++ ) {
+    struct factor_info current = the_factors[i];
+    for ( j = i; j > 0 && mpz_cmp( the_factors[j-1].the_factor, current.the_factor ) > 0; j-- )
+      the_factors[j] = the_factors[j-1];
+    the_factors[j] = current;
+  }
+
+  long count = 0;
+  for ( i = 0; i < Factor_Infos->count; i++ ) {
+    if ( count > 0 && mpz_cmp( the_factors[count-1].the_factor, the_factors[i].the_factor ) == 0 ) {
+      the_factors[count-1].occurrences += the_factors[i].occurrences;
+      continue;
+    }
+    // swap rather than copy so the merged away slot stays initialized
+    struct factor_info current = the_factors[count];
+    the_factors[count++] = the_factors[i];
+    the_factors[i] = current;
+  }
+  Factor_Infos->count = count;
+}
+
+// Print in the p^k.q format, with a trailing 'C' on composite factors
+void Print_Factor_Infos( struct factor_infos* Factor_Infos ) {
+  if ( Factor_Infos == NULL )
+    return;
+
+  printf("\n");
+  long i = 0;
+  for ( ; i < Factor_Infos->count; i++ ) {
+    if ( i > 0 )
+      printf( ".");
+
+    gmp_printf( "%Zd", Factor_Infos->the_factors[i].the_factor );
+
+    if ( Factor_Infos->the_factors[i].factor_status == 'C' )
+      printf("C");
+
+    if ( Factor_Infos->the_factors[i].occurrences > 1 )
+      printf( "^%ld", Factor_Infos->the_factors[i].occurrences );
+  }
+  printf("\n");
+}
+
+// Free the memory allocated
+void Cleanup_Factor_Infos( struct factor_infos* Factor_Infos ) {
+  if ( Factor_Infos == NULL )
+    return;
+
+  long i;
+  for ( i = 0; i < Factor_Infos->capacity; i++ )
+    mpz_clear( Factor_Infos->the_factors[i].the_factor );
+
+  if ( Factor_Infos->the_factors != NULL ) {
+    free( Factor_Infos->the_factors );
+    Factor_Infos->the_factors = NULL;
+  }
+  Factor_Infos->count = 0;
+  Factor_Infos->capacity = 0;
+}
@@ -0,0 +1,39 @@
+/* Public Domain.  See the LICENSE file.                                     */
+
+/* The factor list shared by the factoring programs.  Originally lived in    */
+/* WheelTF.c.                                                                */
+
+#ifndef FACTOR_INFOS_H
+#define FACTOR_INFOS_H
+
+#include <gmp.h>
+
+struct factor_info {
+mpz_t           the_factor;
+long            occurrences;
+char            factor_status;
+};
+
+// Slots count .. capacity - 1 are initialized but unused
+struct factor_infos {
+long                 count;
+long                 capacity;
+struct factor_info*  the_factors;
+};
+
+#define FACTOR_INFOS_MIN_CAPACITY  8
+
+char quickprimecheck( mpz_t );
+long ComputeOccurrences( mpz_t, mpz_t );
+void Init_Factor_Infos( struct factor_infos* );
+void Reserve_Factor_Infos( struct factor_infos*, long );
+void Reset_Factor_Infos( struct factor_infos* );
+void AddFactorInfo( struct factor_infos*, mpz_t, long, char );
+void AddFactorInfoUI( struct factor_infos*, unsigned long, long, char );
+void Add_Split( struct factor_infos*, mpz_t, mpz_t );
+void Add_Split_Scratch( struct factor_infos*, mpz_t, mpz_t, mpz_t );
+void Sort_Factor_Infos( struct factor_infos* );
+void Print_Factor_Infos( struct factor_infos* );
+void Cleanup_Factor_Infos( struct factor_infos* );
+
+#endif
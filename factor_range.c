@@ -0,0 +1,425 @@
+/* Public Domain.  See the LICENSE file.                                     */
+
+/* Factors every number in a range at once, with a segmented sieve.          */
+
+/* The primes up to sqrt(end) are found as in prime_range2.c.  The range is  */
+/* then cut into segments of SEGMENT_SIZE numbers (or the machine profile's  */
+/* factor_range.segment_size, see profile.c).  Each segment keeps a          */
+/* residual per number, starting at the number itself, and every prime p     */
+/* with p^2 <= the top of the segment walks its multiples (found with the    */
+/* same offset arithmetic as prime_range2.c), dividing p out of their        */
+/* residuals as many times as it goes.  Whatever residual is left over is 1  */
+/* or the one prime factor above sqrt.                                       */
+/*                                                                           */
+/* Segments are shared out between threads (thread t takes segments t,      */
+/* t + threads, ...) and each formats its own output.  The main thread       */
+/* writes the segments in order, so the output is the same for any number    */
+/* of threads.  One line per number, in the p^k.q format of WheelTF.         */
+/*                                                                           */
+/* Every base prime costs one division per segment, so this is meant for     */
+/* ranges up to about 10^14.  Nearer 10^18 the base primes alone go up to    */
+/* 10^9.                                                                     */
+
+/* No dependencies other than pthreads.                                      */
+/* On linux, try:                                                            */
+/*   cc -O2 factor_range.c stats.c profile.c -lpthread -o factor_range       */
+/* --stats (or --stats=json) reports the work done, see stats.c.             */
+
+/* eg. try: ./factor_range 1000000000000 1000000000100                       */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "stats.h"
+#include "profile.h"
+
+#define SEGMENT_SIZE   32768
+#define MAX_FACTORS    15      // distinct primes of a number <= 10^18, less the largest
+#define LINE_MAX_CHARS 128
+
+unsigned int  mask[32] = {0x00000001,0x00000002,0x00000004,0x00000008,
+                          0x00000010,0x00000020,0x00000040,0x00000080,
+                          0x00000100,0x00000200,0x00000400,0x00000800,
+                          0x00001000,0x00002000,0x00004000,0x00008000,
+                          0x00010000,0x00020000,0x00040000,0x00080000,
+                          0x00100000,0x00200000,0x00400000,0x00800000,
+                          0x01000000,0x02000000,0x04000000,0x08000000,
+                          0x10000000,0x20000000,0x40000000,0x80000000 };
+
+struct range_job {
+int64_t         begin;
+int64_t         end;
+uint32_t*       primes;            // all primes <= sqrt(end)
+int64_t         prime_count;
+int64_t         segment_size;
+int64_t         segment_count;
+int             threads;
+};
+
+struct text_buffer {
+char*           text;
+size_t          length;
+size_t          capacity;
+};
+
+// One per thread.  The slot hands a finished segment to the main thread.
+struct range_worker {
+struct range_job*   job;
+int                 id;
+pthread_t           thread;
+pthread_mutex_t     lock;
+pthread_cond_t      cond;
+struct text_buffer  slot;
+int64_t             slot_segment;  // segment in slot, -1 if free
+int                 failed;
+uint64_t            divisions;     // for --stats
+uint64_t            sieving_primes;
+};
+
+int64_t isqrt( int64_t number );
+uint32_t* Base_Primes( int64_t, int64_t* );
+void* Range_Worker( void* );
+int Factor_Segment( struct range_worker*, int64_t, int64_t, uint64_t*, uint8_t*, uint32_t*, uint8_t*, struct text_buffer* );
+int Reserve_Text( struct text_buffer*, size_t );
+char* Append_U64( char*, uint64_t );
+
+int main( int argc, char * argv[] ) {
+
+  struct stats stats;
+  Stats_Init( &stats, &argc, argv );
+
+  int threads = (int) Profile_Get( "factor_range.threads", sysconf( _SC_NPROCESSORS_ONLN ) );
+
+  int argi = 1;
+  if ( argc == 5 && !strcmp( argv[1], "-t" ) ) {
+    threads = atoi( argv[2] );
+    argi = 3;
+  }
+
+  if ( argc - argi != 2 ) {
+    fprintf( stderr, "Usage: factor_range [-t threads] [--stats[=json]] start end\n");
+    return 1;
+  }
+
+  if ( threads < 1 )
+    threads = 1;
+
+  int64_t begin = atol( argv[argi] );
+  int64_t max_limit = 1000000000000000000L;
+  if ( begin < 1 || begin > max_limit ) {
+    fprintf( stderr, "Error: begin range must >= 1 and <= %ld. Aborting.\n\n", max_limit );
+    return 1;
+  }
+
+  int64_t end = atol( argv[argi + 1] );
+  if ( end < 1 || end > max_limit ) {
+    fprintf( stderr, "Error: end range must >= 1 and <= %ld. Aborting.\n\n", max_limit );
+    return 1;
+  }
+
+  if ( begin > end ) {
+    fprintf( stderr, "Error: Begin range must be less than end range. Aborting.\n\n" );
+    return 1;
+  }
+
+  struct range_job job;
+  memset( &job, 0, sizeof(job) );
+  job.begin = begin;
+  job.end = end;
+  job.segment_size = Profile_Get( "factor_range.segment_size", SEGMENT_SIZE );
+  if ( job.segment_size < 1024 )
+    job.segment_size = SEGMENT_SIZE;
+  job.segment_count = (end - begin) / job.segment_size + 1;
+  job.threads = threads < job.segment_count ? threads : (int) job.segment_count;
+
+  Stats_Phase_Start( &stats, "base primes" );
+  job.primes = Base_Primes( isqrt(end) + 1, &job.prime_count );
+  Stats_Phase_Stop( &stats );
+  Stats_Count( &stats, "primes", job.prime_count );
+
+  if ( job.primes == NULL ) {
+    fprintf( stderr, "Error: Failed to allocate memory (base primes). Aborting.\n\n" );
+    return 1;
+  }
+
+  Stats_Phase_Start( &stats, "factor range" );
+
+  struct range_worker* workers = (struct range_worker*) calloc( job.threads, sizeof(struct range_worker) );
+  if ( workers == NULL ) {
+    fprintf( stderr, "Error: Failed to allocate memory (workers). Aborting.\n\n" );
+    free( job.primes );
+    return 1;
+  }
+
+  int t;
+  for ( t = 0; t < job.threads; t++ ) {
+    workers[t].job = &job;
+    workers[t].id = t;
+    workers[t].slot_segment = -1;
+    pthread_mutex_init( &workers[t].lock, NULL );
+    pthread_cond_init( &workers[t].cond, NULL );
+    pthread_create( &workers[t].thread, NULL, Range_Worker, &workers[t] );
+  }
+
+  // write the segments out in order as they come in
+  int failed = 0;
+  int64_t segment;
+  for ( segment = 0; segment < job.segment_count && !failed; segment++ ) {
+    struct range_worker* worker = &workers[segment % job.threads];
+    pthread_mutex_lock( &worker->lock );
+    while ( worker->slot_segment != segment && !worker->failed )
+      pthread_cond_wait( &worker->cond, &worker->lock );
+    if ( worker->failed )
+      failed = 1;
+    else
+      fwrite( worker->slot.text, 1, worker->slot.length, stdout );
+    worker->slot_segment = -1;
+    pthread_cond_signal( &worker->cond );
+    pthread_mutex_unlock( &worker->lock );
+  }
+
+  uint64_t divisions = 0;
+  uint64_t sieving_primes = 0;
+  for ( t = 0; t < job.threads; t++ ) {
+    // a failed run stops reading, so release anyone still waiting
+    pthread_mutex_lock( &workers[t].lock );
+    workers[t].failed |= failed;
+    pthread_cond_signal( &workers[t].cond );
+    pthread_mutex_unlock( &workers[t].lock );
+
+    pthread_join( workers[t].thread, NULL );
+    divisions += workers[t].divisions;
+    sieving_primes += workers[t].sieving_primes;
+    pthread_cond_destroy( &workers[t].cond );
+    pthread_mutex_destroy( &workers[t].lock );
+    free( workers[t].slot.text );
+  }
+
+  Stats_Phase_Stop( &stats );
+  Stats_Count( &stats, "segments", job.segment_count );
+  Stats_Count( &stats, "sieving primes (summed)", sieving_primes );
+  Stats_Count( &stats, "residual divisions", divisions );
+  Stats_Count( &stats, "numbers factored", end - begin + 1 );
+  Stats_Print( &stats, stderr );
+  Stats_Cleanup( &stats );
+
+  free( workers );
+  free( job.primes );
+
+  if ( failed ) {
+    fprintf( stderr, "Error: Failed to allocate memory (segment). Aborting.\n\n" );
+    return 1;
+  }
+
+  return 0;
+}
+
+// Sieve of Eratosthenes up to limit, as chunk1 in prime_range2.c.  Returns
+// the primes, or NULL if out of memory.
+uint32_t* Base_Primes( int64_t limit, int64_t* count ) {
+  int64_t size = limit / 32 + 1;
+  uint32_t* sieve = (uint32_t *) calloc( size, sizeof(uint32_t) );
+  if ( sieve == NULL )
+    return NULL;
+  sieve[0] |= mask[0]; // corresponds to the number 0 which is not prime
+  sieve[0] |= mask[1]; // corresponds to the number 1 which is not prime
+
+  int64_t i, j;
+  for ( i = 2; i * i <= limit; i++ )
+    if ( !(mask[i & 0x1F] & sieve[i >> 5]) )
+      for ( j = i * i; j <= limit; j += i )
+        sieve[j >> 5] |= mask[j & 0x1F];
+
+  *count = 0;
+  for ( i = 2; i <= limit; i++ )
+    if ( !(mask[i & 0x1F] & sieve[i >> 5]) )
+      (*count)++;
+
+  uint32_t* primes = (uint32_t *) malloc( (*count + 1) * sizeof(uint32_t) );
+  if ( primes != NULL ) {
+    int64_t k = 0;
+    for ( i = 2; i <= limit; i++ )
+      if ( !(mask[i & 0x1F] & sieve[i >> 5]) )
+        primes[k++] = (uint32_t) i;
+  }
+
+  free( sieve );
+  return primes;
+}
+
+// Factor segments id, id + threads, ... and hand each one over in turn
+void* Range_Worker( void* arg ) {
+  struct range_worker* worker = (struct range_worker*) arg;
+  struct range_job* job = worker->job;
+
+  uint64_t* residual = (uint64_t *) malloc( job->segment_size * sizeof(uint64_t) );
+  uint8_t*  factor_count = (uint8_t *) malloc( job->segment_size );
+  uint32_t* factors = (uint32_t *) malloc( (size_t) job->segment_size * MAX_FACTORS * sizeof(uint32_t) );
+  uint8_t*  exponents = (uint8_t *) malloc( (size_t) job->segment_size * MAX_FACTORS );
+  struct text_buffer work = { NULL, 0, 0 };
+
+  int ok = residual != NULL && factor_count != NULL && factors != NULL && exponents != NULL;
+
+  int64_t segment;
+  for ( segment = worker->id; segment < job->segment_count && ok; segment += job->threads ) {
+    int64_t lo = job->begin + segment * job->segment_size;
+    int64_t length = job->end - lo + 1 < job->segment_size ? job->end - lo + 1 : job->segment_size;
+
+    if ( !Factor_Segment( worker, lo, length, residual, factor_count, factors, exponents, &work ) ) {
+      ok = 0;
+      break;
+    }
+
+    // wait for the main thread to take the previous one, then swap buffers
+    pthread_mutex_lock( &worker->lock );
+    while ( worker->slot_segment != -1 && !worker->failed )
+      pthread_cond_wait( &worker->cond, &worker->lock );
+    if ( worker->failed )
+      ok = 0;
+    struct text_buffer swap = worker->slot;
+    worker->slot = work;
+    work = swap;
+    worker->slot_segment = segment;
+    pthread_cond_signal( &worker->cond );
+    pthread_mutex_unlock( &worker->lock );
+  }
+
+  if ( !ok ) {
+    pthread_mutex_lock( &worker->lock );
+    worker->failed = 1;
+    pthread_cond_signal( &worker->cond );
+    pthread_mutex_unlock( &worker->lock );
+  }
+
+  free( work.text );
+  free( exponents );
+  free( factors );
+  free( factor_count );
+  free( residual );
+
+  return NULL;
+}
+
+// Factor lo .. lo + length - 1 into out as text.  Returns 0 if out of memory.
+int Factor_Segment( struct range_worker* worker, int64_t lo, int64_t length, uint64_t* residual,
+                    uint8_t* factor_count, uint32_t* factors, uint8_t* exponents, struct text_buffer* out ) {
+  struct range_job* job = worker->job;
+
+  int64_t i;
+  for ( i = 0; i < length; i++ )
+    residual[i] = (uint64_t) (lo + i);
+  memset( factor_count, 0, length );
+
+  uint64_t hi = (uint64_t) (lo + length - 1);
+  uint64_t divisions = 0;
+  int64_t k;
+  for ( k = 0; k < job->prime_count; k++ ) {
+    uint64_t p = job->primes[k];
+    if ( p * p > hi )
+      break;
+
+    int64_t offset = ((lo / (int64_t) p) * (int64_t) p) - lo; // calculate offset into the segment
+    if ( offset < 0 )
+      offset += p;
+
+    for ( ; offset < length; offset += p ) {
+      uint64_t r = residual[offset] / p;
+      uint8_t e = 1;
+      while ( r % p == 0 ) {
+        r /= p;
+        e++;
+      }
+      residual[offset] = r;
+      factors[offset * MAX_FACTORS + factor_count[offset]] = (uint32_t) p;
+      exponents[offset * MAX_FACTORS + factor_count[offset]] = e;
+      factor_count[offset]++;
+      divisions += e;
+    }
+  }
+  worker->divisions += divisions;
+  worker->sieving_primes += k;
+
+  // "n = p^k.q\n" fits in LINE_MAX_CHARS:  20 + 3 digits and " = ", then
+  // the factors' digits add up to at most 18 + 16, plus 16 "^k" and 15 dots
+  out->length = 0;
+  if ( !Reserve_Text( out, (size_t) length * LINE_MAX_CHARS ) )
+    return 0;
+
+  char* s = out->text;
+  for ( i = 0; i < length; i++ ) {
+    s = Append_U64( s, (uint64_t) (lo + i) );
+    *s++ = ' ';
+    *s++ = '=';
+    *s++ = ' ';
+
+    int f;
+    for ( f = 0; f < factor_count[i]; f++ ) {
+      if ( f > 0 )
+        *s++ = '.';
+      s = Append_U64( s, factors[i * MAX_FACTORS + f] );
+      if ( exponents[i * MAX_FACTORS + f] > 1 ) {
+        *s++ = '^';
+        s = Append_U64( s, exponents[i * MAX_FACTORS + f] );
+      }
+    }
+
+    // the leftover is 1 or a prime above sqrt(hi).  1 itself is shown as 1
+    if ( residual[i] > 1 || factor_count[i] == 0 ) {
+      if ( factor_count[i] > 0 )
+        *s++ = '.';
+      s = Append_U64( s, residual[i] );
+    }
+    *s++ = '\n';
+  }
+  out->length = s - out->text;
+
+  return 1;
+}
+
+int Reserve_Text( struct text_buffer* buffer, size_t capacity ) {
+  if ( capacity <= buffer->capacity )
+    return 1;
+
+  char* text = (char *) realloc( buffer->text, capacity );
+  if ( text == NULL )
+    return 0;
+  buffer->text = text;
+  buffer->capacity = capacity;
+  return 1;
+}
+
+// Write v in decimal at s, returning the end
+char* Append_U64( char* s, uint64_t v ) {
+  char digits[20];
+  int n = 0;
+  do {
+    digits[n++] = (char) ('0' + v % 10);
+    v /= 10;
+  } while ( v != 0 );
+
+  while ( n > 0 )
+    *s++ = digits[--n];
+  return s;
+}
+
+// Simple integer square root algorithm from Google AI search
+int64_t isqrt( int64_t number ) {
+  int64_t a = number;
+  int64_t b = (number + 1) / 2; // Initial guess
+
+  while (a > b) {
+    a = b;
+    b = (b + number / b) / 2;
+  }
+
+  // Ensure the result is the floor of the square root
+  if (a * a > number)
+    a--;
+
+  return a;
+}
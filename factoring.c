@@ -0,0 +1,75 @@
+/* Public Domain.  See the LICENSE file.                                     */
+
+/* The context based entry points of libfactoring.  A struct factor_ctx      */
+/* owns the mpz temporaries the engines need, and the caller keeps its       */
+/* struct factor_infos between calls (see Reserve_Factor_Infos()), so once   */
+/* the limbs have grown to the size of the numbers being worked on, repeated */
+/* calls do no heap allocation at all.                                       */
+/*                                                                           */
+/* The primality tests done inside factor_tf() and factor_rho() use the      */
+/* per thread scratch in primality.c, which is likewise only allocated once. */
+
+/* Build instructions are in factoring.h.                                    */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <gmp.h>
+
+#include "factoring.h"
+
+// Set up ctx with room for numbers of up to bits bits (it grows as needed)
+void factor_ctx_init( struct factor_ctx* ctx, unsigned long bits ) {
+  if ( ctx == NULL )
+    return;
+
+  // squares are formed in x, y before reducing
+  mpz_init2( ctx->running_N, bits );
+  mpz_init2( ctx->square_root, bits / 2 + 1 );
+  mpz_init2( ctx->x, 2 * bits );
+  mpz_init2( ctx->y, 2 * bits );
+  mpz_init2( ctx->t, bits );
+  mpz_init2( ctx->d, bits );
+  mpz_init2( ctx->cofactor, bits );
+  Init_Prime_Scratch( &ctx->prime );
+}
+
+void factor_ctx_clear( struct factor_ctx* ctx ) {
+  if ( ctx == NULL )
+    return;
+
+  mpz_clears( ctx->running_N, ctx->square_root, ctx->x, ctx->y, ctx->t, ctx->d, ctx->cofactor, NULL );
+  Clear_Prime_Scratch( &ctx->prime );
+}
+
+// Trial factor n with primes up to tf_limit, replacing the contents of out.
+// As WheelTFLimit(), the last entry is whatever is left over.
+void factor_tf( struct factor_ctx* ctx, mpz_t n, unsigned long tf_limit, struct factor_infos* out ) {
+  if ( ctx == NULL || out == NULL )
+    return;
+
+  Reset_Factor_Infos( out );
+  WheelTF_Scratch( n, tf_limit, ctx->running_N, ctx->square_root, out );
+}
+
+// Run rho with x^2 + c for at most max_iterations steps (no limit if
+// negative).  Returns 1 with out replaced by the two pieces of n, smallest
+// first, or 0 with out emptied.
+int factor_rho( struct factor_ctx* ctx, mpz_t n, unsigned long c, long max_iterations, struct factor_infos* out ) {
+  if ( ctx == NULL || out == NULL )
+    return 0;
+
+  Reset_Factor_Infos( out );
+  if ( !Rho_Scratch( n, c, max_iterations, ctx->d, ctx->x, ctx->y, ctx->t ) )
+    return 0;
+
+  Add_Split_Scratch( out, n, ctx->d, ctx->cofactor );
+  return 1;
+}
+
+// As Prime_Status():  'P', 'C' or 'N'
+char is_prime( struct factor_ctx* ctx, mpz_t n ) {
+  if ( ctx == NULL )
+    return Prime_Status( n );
+  return Prime_Status_Scratch( n, &ctx->prime );
+}
@@ -0,0 +1,58 @@
+/* Public Domain.  See the LICENSE file.                                     */
+
+/* libfactoring:  the engines behind WheelTF, rho, ecm, siqs and the         */
+/* primality tests, and the prime iterator (prime_iter.h), as one library   */
+/* usable from C or C++.  See factoring.c.                                   */
+/*                                                                           */
+/* The library exports only what the headers below declare:  the factor_*    */
+/* and prime_iter_* functions, and the engines' documented entry points.     */
+/* Every helper is static to its file.                                       */
+
+/* To build, the GMP library needs to be already installed.                  */
+/* See https://gmplib.org                                                    */
+/* "make libfactoring.a", or on linux, try:                                  */
+/*   cc -O2 -DFACTOR_NO_MAIN -c factoring.c factor_infos.c primality.c       */
+/*      WheelTF.c rho.c ecm.c siqs.c prime_iter.c                            */
+/*   ar rcs libfactoring.a factoring.o factor_infos.o primality.o WheelTF.o  */
+/*      rho.o ecm.o siqs.o prime_iter.o                                      */
+/* and link with:  -L. -lfactoring -lgmp -lm -lpthread                       */
+
+#ifndef FACTORING_H
+#define FACTORING_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <gmp.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "factor_infos.h"
+#include "primality.h"
+#include "WheelTF.h"
+#include "rho.h"
+#include "ecm.h"
+#include "siqs.h"
+#include "prime_iter.h"
+
+// Temporaries reused by every call made with the context.  One context per
+// thread; contexts share nothing, so calls on different contexts can run
+// at the same time.
+struct factor_ctx {
+mpz_t                 running_N, square_root;      // factor_tf
+mpz_t                 x, y, t, d, cofactor;        // factor_rho
+struct prime_scratch  prime;                       // is_prime
+};
+
+void factor_ctx_init( struct factor_ctx*, unsigned long );
+void factor_ctx_clear( struct factor_ctx* );
+void factor_tf( struct factor_ctx*, mpz_t, unsigned long, struct factor_infos* );
+int factor_rho( struct factor_ctx*, mpz_t, unsigned long, long, struct factor_infos* );
+char is_prime( struct factor_ctx*, mpz_t );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -6,21 +6,30 @@
 
 /* To compile, the GMP library needs to be already installed.                */
 /* See https://gmplib.org                                                    */
-/* On linux, try:  cc fermat.c -lgmp -o fermat                               */
+/* On linux, try:                                                            */
+/*   cc fermat.c primality.c stats.c -lgmp -lpthread -o fermat               */
 
 /* eg. try: ./fermat 5959                                                    */
+/* --stats (or --stats=json) reports the work done, see stats.c.             */
 
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <gmp.h>
 
+#include "primality.h"
+#include "stats.h"
+
 
 
 int main(int argc , char * argv[]) {
 
+  struct stats stats;
+  Stats_Init( &stats, &argc, argv );
+
   if (argc != 2) {
-    printf("\nUsage: fermat N\n");
+    printf("\nUsage: fermat [--stats[=json]] N\n");
     return 1;
   }
 
@@ -41,7 +50,7 @@ int main(int argc , char * argv[]) {
     return 1;
   }
 
-  if ( mpz_probab_prime_p( n, 30 ) ) {
+  if ( Prime_Status( n ) == 'P' ) {
     printf( "N is a probable prime. Aborting.\n\n" );
     mpz_clear( n );
     return 1;
@@ -71,13 +80,20 @@ int main(int argc , char * argv[]) {
   mpz_mul( tempZ1, a, a );
   mpz_sub( b2, tempZ1, n );
 
+  Stats_Phase_Start( &stats, "search" );
+
+  uint64_t square_tests = 1;
   while ( !mpz_perfect_square_p( b2 ) ) {
     mpz_mul_2exp( tempZ1, a, 1 );
     mpz_add( b2, b2, tempZ1 );
     mpz_add_ui( b2, b2, 1 );
     mpz_add_ui( a, a, 1 );
+    square_tests++;
   }
 
+  Stats_Phase_Stop( &stats );
+  Stats_Count( &stats, "perfect square tests", square_tests );
+
   mpz_t b;
   mpz_init( b );
   mpz_sqrt( b, b2 );
@@ -92,6 +108,9 @@ int main(int argc , char * argv[]) {
 
   gmp_printf( "%Zd %Zd\n", a_plus_b, a_minus_b );
 
+  Stats_Print( &stats, stderr );
+  Stats_Cleanup( &stats );
+
   mpz_clear( a_plus_b );
   mpz_clear( a_minus_b );
   mpz_clear( b );
@@ -0,0 +1,510 @@
+/* Public Domain.  See the LICENSE file.                                     */
+
+/* Primality tests used by the factoring programs in place of                */
+/* mpz_probab_prime_p( n, 30 ).                                              */
+/*                                                                           */
+/*   - n < 2^64:  Miller-Rabin on native words with the first 12 prime       */
+/*                bases, which is deterministic below 3.3 x 10^24.           */
+/*   - otherwise: BPSW, ie. a strong base 2 test followed by a strong Lucas  */
+/*                test with Selfridge's parameters.  No BPSW pseudoprime is  */
+/*                known.                                                     */
+/*   - Prime_Certify() proves primality with Pocklington's n - 1 test when   */
+/*     enough of n - 1 can be factored, and prints the certificate.          */
+/*     ECPP and APR-CL are not implemented, so a large prime whose n - 1 is  */
+/*     hard to factor comes back as unproven.                                */
+/*                                                                           */
+/* Prime_Status() remembers the last number above 64 bits it looked at (per  */
+/* thread), so the same running N tested again by the next tier is free.     */
+/* Its temporaries live in a struct prime_scratch kept per thread too, so    */
+/* after the first call no test allocates.  It is freed when the thread      */
+/* exits.  Prime_Status_Scratch() takes the caller's own scratch instead,    */
+/* see factoring.c.                                                          */
+
+/* To compile, the GMP library needs to be already installed.                */
+/* See https://gmplib.org                                                    */
+/* Linked into the other programs, eg.                                       */
+/*   cc rho.c primality.c -lgmp -lpthread -o rho                             */
+
+/* Some test numbers:                                                        */
+/*   18446744073709551557         --> prime (2^64 - 59)                      */
+/*   3825123056546413051          --> composite, strong pseudoprime to the   */
+/*                                    first 9 prime bases                    */
+/*   318665857834031151167461     --> composite, strong pseudoprime to the   */
+/*                                    first 12 prime bases, caught by Lucas  */
+/*   2^127 - 1                    --> proven by Prime_Certify()              */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <gmp.h>
+
+#include "primality.h"
+
+#define CERTIFY_TF_LIMIT     65536
+#define CERTIFY_RHO_LIMIT    200000
+#define CERTIFY_MAX_FACTORS  64
+
+static const uint32_t mr_bases[12] = { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37 };
+
+// Scratch, and last number tested, for Prime_Status() on each thread.
+// Allocated on a thread's first call, and cleared by the key's destructor
+// when the thread exits.
+static pthread_once_t  scratch_once = PTHREAD_ONCE_INIT;
+static pthread_key_t   scratch_key;
+
+static uint64_t mulmod64( uint64_t, uint64_t, uint64_t );
+static uint64_t powmod64( uint64_t, uint64_t, uint64_t );
+static struct prime_scratch* Thread_Scratch( void );
+static void Make_Scratch_Key( void );
+static void Free_Thread_Scratch( void* );
+static int Strong_Lucas( mpz_t, struct prime_scratch* );
+static int Factor_N_Minus_1( mpz_t, mpz_t, mpz_t*, int* );
+static int Brent_Rho( mpz_t, mpz_t );
+
+void Init_Prime_Scratch( struct prime_scratch* scratch ) {
+  mpz_inits( scratch->d, scratch->x, scratch->n_minus_1, scratch->D_z, scratch->U, scratch->V,
+             scratch->Qk, scratch->t, scratch->last_n, NULL );
+  scratch->last_status = 0;
+}
+
+void Clear_Prime_Scratch( struct prime_scratch* scratch ) {
+  mpz_clears( scratch->d, scratch->x, scratch->n_minus_1, scratch->D_z, scratch->U, scratch->V,
+              scratch->Qk, scratch->t, scratch->last_n, NULL );
+}
+
+static struct prime_scratch* Thread_Scratch( void ) {
+  pthread_once( &scratch_once, Make_Scratch_Key );
+  struct prime_scratch* scratch = (struct prime_scratch*) pthread_getspecific( scratch_key );
+  if ( scratch == NULL ) {
+    scratch = (struct prime_scratch*) malloc( sizeof(struct prime_scratch) );
+    if ( scratch == NULL ) {
+      fprintf( stderr, "Error: Failed to allocate memory. Aborting.\n\n" );
+      exit( 1 );
+    }
+    Init_Prime_Scratch( scratch );
+    pthread_setspecific( scratch_key, scratch );
+  }
+  return scratch;
+}
+
+static void Make_Scratch_Key( void ) {
+  pthread_key_create( &scratch_key, Free_Thread_Scratch );
+}
+
+static void Free_Thread_Scratch( void* scratch ) {
+  Clear_Prime_Scratch( (struct prime_scratch*) scratch );
+  free( scratch );
+}
+
+// Returns number type.  'C' --> Composite, 'P' --> Prime (BPSW probable
+// prime above 2^64), 'N' --> Neither (ie. the number 1)
+char Prime_Status( mpz_t n ) {
+  return Prime_Status_Scratch( n, NULL );
+}
+
+// Prime_Status() using scratch, or this thread's scratch if NULL
+char Prime_Status_Scratch( mpz_t n, struct prime_scratch* scratch ) {
+  if ( mpz_cmp_ui( n, 1 ) == 0 )
+    return 'N';
+  if ( mpz_cmp_ui( n, 2 ) < 0 )
+    return 'C';
+
+  if ( mpz_sizeinbase( n, 2 ) <= 64 )
+    return Is_Prime_U64( (uint64_t) mpz_get_ui( n ) ) ? 'P' : 'C';
+
+  if ( scratch == NULL )
+    scratch = Thread_Scratch();
+
+  if ( scratch->last_status != 0 && mpz_cmp( n, scratch->last_n ) == 0 )
+    return scratch->last_status;
+
+  char status = BPSW_Scratch( n, scratch ) ? 'P' : 'C';
+
+  mpz_set( scratch->last_n, n );
+  scratch->last_status = status;
+
+  return status;
+}
+
+// Deterministic Miller-Rabin for 64 bit n
+int Is_Prime_U64( uint64_t n ) {
+  if ( n < 2 )
+    return 0;
+
+  int i;
+  for ( i = 0; i < 12; i++ ) {
+    if ( n == mr_bases[i] )
+      return 1;
+    if ( n % mr_bases[i] == 0 )
+      return 0;
+  }
+
+  uint64_t d = n - 1;
+  int s = 0;
+  while ( (d & 1) == 0 ) {
+    d >>= 1;
+    s++;
+  }
+
+  for ( i = 0; i < 12; i++ ) {
+    uint64_t x = powmod64( mr_bases[i], d, n );
+    if ( x == 1 || x == n - 1 )
+      continue;
+
+    int r;
+    for ( r = 1; r < s; r++ ) {
+      x = mulmod64( x, x, n );
+      if ( x == n - 1 )
+        break;
+    }
+    if ( r == s )
+      return 0;
+  }
+
+  return 1;
+}
+
+// Baillie-PSW probable prime test
+int BPSW( mpz_t n ) {
+  return BPSW_Scratch( n, NULL );
+}
+
+// BPSW() using scratch, or this thread's scratch if NULL
+int BPSW_Scratch( mpz_t n, struct prime_scratch* scratch ) {
+  if ( mpz_cmp_ui( n, 2 ) < 0 )
+    return 0;
+  if ( mpz_sizeinbase( n, 2 ) <= 64 )
+    return Is_Prime_U64( (uint64_t) mpz_get_ui( n ) );
+
+  int i;
+  for ( i = 0; i < 12; i++ )
+    if ( mpz_divisible_ui_p( n, mr_bases[i] ) )
+      return 0;
+
+  if ( scratch == NULL )
+    scratch = Thread_Scratch();
+
+  // strong probable prime to base 2
+  mpz_ptr d = scratch->d, x = scratch->x, n_minus_1 = scratch->n_minus_1;
+  mpz_sub_ui( n_minus_1, n, 1 );
+  unsigned long s = mpz_scan1( n_minus_1, 0 );
+  mpz_fdiv_q_2exp( d, n_minus_1, s );
+
+  mpz_set_ui( x, 2 );
+  mpz_powm( x, x, d, n );
+  int sprp = mpz_cmp_ui( x, 1 ) == 0 || mpz_cmp( x, n_minus_1 ) == 0;
+  unsigned long r;
+  for ( r = 1; r < s && !sprp; r++ ) {
+    mpz_mul( x, x, x );
+    mpz_mod( x, x, n );
+    if ( mpz_cmp( x, n_minus_1 ) == 0 )
+      sprp = 1;
+  }
+
+  if ( !sprp )
+    return 0;
+
+  return Strong_Lucas( n, scratch );
+}
+
+// Strong Lucas probable prime test, Selfridge's method A:  D is the first of
+// 5, -7, 9, -11, ... with (D/n) == -1, P = 1, Q = (1 - D) / 4.
+static int Strong_Lucas( mpz_t n, struct prime_scratch* scratch ) {
+  if ( mpz_perfect_square_p( n ) )
+    return 0;
+
+  mpz_ptr D_z = scratch->D_z;
+  long D = 5;
+  for ( ;; ) {
+    mpz_set_si( D_z, D );
+    int j = mpz_jacobi( D_z, n );
+    if ( j == -1 )
+      break;
+    if ( j == 0 && mpz_cmpabs_ui( n, labs( D ) ) != 0 )
+      return 0;
+    D = D > 0 ? -(D + 2) : -D + 2;
+  }
+  long Q = (1 - D) / 4;
+
+  // n + 1 = d . 2^s
+  mpz_ptr d = scratch->d, U = scratch->U, V = scratch->V, Qk = scratch->Qk, t = scratch->t;
+  mpz_add_ui( d, n, 1 );
+  unsigned long s = mpz_scan1( d, 0 );
+  mpz_fdiv_q_2exp( d, d, s );
+
+  mpz_set_ui( U, 1 );
+  mpz_set_ui( V, 1 );           // P = 1
+  mpz_set_si( Qk, Q );
+  mpz_mod( Qk, Qk, n );
+
+  long bit;
+  for ( bit = (long) mpz_sizeinbase( d, 2 ) - 2; bit >= 0; bit-- ) {
+    // double:  U_2k = U_k.V_k,  V_2k = V_k^2 - 2.Q^k
+    mpz_mul( U, U, V );
+    mpz_mod( U, U, n );
+    mpz_mul( V, V, V );
+    mpz_submul_ui( V, Qk, 2 );
+    mpz_mod( V, V, n );
+    mpz_mul( Qk, Qk, Qk );
+    mpz_mod( Qk, Qk, n );
+
+    if ( mpz_tstbit( d, bit ) ) {
+      // add one:  U_k+1 = (U_k + V_k) / 2,  V_k+1 = (D.U_k + V_k) / 2
+      mpz_mul_si( t, U, D );
+      mpz_add( U, U, V );
+      if ( mpz_odd_p( U ) )
+        mpz_add( U, U, n );
+      mpz_fdiv_q_2exp( U, U, 1 );
+      mpz_mod( U, U, n );
+
+      mpz_add( V, V, t );
+      mpz_mod( V, V, n );
+      if ( mpz_odd_p( V ) )
+        mpz_add( V, V, n );
+      mpz_fdiv_q_2exp( V, V, 1 );
+
+      mpz_mul_si( Qk, Qk, Q );
+      mpz_mod( Qk, Qk, n );
+    }
+  }
+
+  int retval = mpz_sgn( U ) == 0 || mpz_sgn( V ) == 0;
+  unsigned long r;
+  for ( r = 1; r < s && !retval; r++ ) {
+    mpz_mul( V, V, V );
+    mpz_submul_ui( V, Qk, 2 );
+    mpz_mod( V, V, n );
+    mpz_mul( Qk, Qk, Qk );
+    mpz_mod( Qk, Qk, n );
+    if ( mpz_sgn( V ) == 0 )
+      retval = 1;
+  }
+
+  return retval;
+}
+
+// Prove n prime.  Returns 1 if proven prime, 0 if composite, -1 if n looks
+// prime but no proof was found.  The certificate goes to out (if not NULL),
+// one line per prime, each relying on the lines printed before it.
+//
+// Pocklington:  if n - 1 = F.R with F > sqrt(n) fully factored, and for
+// every prime q | F some a has a^(n-1) == 1 and gcd(a^((n-1)/q) - 1, n) == 1,
+// then n is prime.
+int Prime_Certify( mpz_t n, FILE* out ) {
+  if ( mpz_cmp_ui( n, 2 ) < 0 )
+    return 0;
+
+  if ( mpz_sizeinbase( n, 2 ) <= 64 ) {
+    if ( !Is_Prime_U64( (uint64_t) mpz_get_ui( n ) ) )
+      return 0;
+    // anything below the trial division limit is taken as self evident
+    if ( out != NULL && mpz_cmp_ui( n, CERTIFY_TF_LIMIT ) >= 0 )
+      gmp_fprintf( out, "%Zd : deterministic Miller-Rabin\n", n );
+    return 1;
+  }
+
+  if ( !BPSW( n ) )
+    return 0;
+
+  mpz_t F, q[CERTIFY_MAX_FACTORS];
+  int q_count = 0;
+  mpz_init( F );
+  int i;
+  for ( i = 0; i < CERTIFY_MAX_FACTORS; i++ )
+    mpz_init( q[i] );
+
+  int retval = -1;
+  if ( !Factor_N_Minus_1( n, F, q, &q_count ) )
+    goto cleanup;
+
+  // every q must itself be proven first
+  for ( i = 0; i < q_count; i++ )
+    if ( Prime_Certify( q[i], out ) != 1 )
+      goto cleanup;
+
+  mpz_t n_minus_1, e, x;
+  mpz_inits( n_minus_1, e, x, NULL );
+  mpz_sub_ui( n_minus_1, n, 1 );
+
+  unsigned long a = 2;
+  unsigned long witnesses[CERTIFY_MAX_FACTORS];
+  for ( i = 0; i < q_count && retval == -1; i++ ) {
+    for ( ; a < 1000; a++ ) {
+      mpz_set_ui( x, a );
+      mpz_powm( x, x, n_minus_1, n );
+      if ( mpz_cmp_ui( x, 1 ) != 0 ) {
+        retval = 0;
+        break;
+      }
+      mpz_divexact( e, n_minus_1, q[i] );
+      mpz_set_ui( x, a );
+      mpz_powm( x, x, e, n );
+      mpz_sub_ui( x, x, 1 );
+      mpz_gcd( x, x, n );
+      if ( mpz_cmp_ui( x, 1 ) == 0 )
+        break;
+    }
+    if ( a == 1000 )
+      break;
+    witnesses[i] = a;
+  }
+
+  if ( retval == -1 && i == q_count ) {
+    retval = 1;
+    if ( out != NULL ) {
+      gmp_fprintf( out, "%Zd : Pocklington, F =", n );
+      for ( i = 0; i < q_count; i++ )
+        gmp_fprintf( out, " %Zd (a=%lu)", q[i], witnesses[i] );
+      fprintf( out, "\n" );
+    }
+  }
+
+  mpz_clears( n_minus_1, e, x, NULL );
+
+cleanup:
+  for ( i = 0; i < CERTIFY_MAX_FACTORS; i++ )
+    mpz_clear( q[i] );
+  mpz_clear( F );
+
+  return retval;
+}
+
+// Find distinct primes q_i dividing n - 1 whose product F (with
+// multiplicity) exceeds sqrt(n).  Returns 1 on success.
+static int Factor_N_Minus_1( mpz_t n, mpz_t F, mpz_t* q, int* q_count ) {
+  mpz_t R, d, stack[CERTIFY_MAX_FACTORS];
+  mpz_inits( R, d, NULL );
+  int stack_count = 0;
+  int i;
+  for ( i = 0; i < CERTIFY_MAX_FACTORS; i++ )
+    mpz_init( stack[i] );
+
+  mpz_sub_ui( R, n, 1 );
+  mpz_set_ui( F, 1 );
+  *q_count = 0;
+
+  // trial division
+  unsigned long p;
+  for ( p = 2; p < CERTIFY_TF_LIMIT && *q_count < CERTIFY_MAX_FACTORS; p += (p == 2 ? 1 : 2) ) {
+    if ( !mpz_divisible_ui_p( R, p ) )
+      continue;
+    mpz_set_ui( q[*q_count], p );
+    (*q_count)++;
+    while ( mpz_divisible_ui_p( R, p ) ) {
+      mpz_divexact_ui( R, R, p );
+      mpz_mul_ui( F, F, p );
+    }
+  }
+
+  // then rho on what is left, smallest pieces first
+  if ( mpz_cmp_ui( R, 1 ) > 0 )
+    mpz_set( stack[stack_count++], R );
+
+  mpz_t F2;
+  mpz_init( F2 );
+  for ( ;; ) {
+    mpz_mul( F2, F, F );
+    if ( mpz_cmp( F2, n ) > 0 || stack_count == 0 || *q_count >= CERTIFY_MAX_FACTORS )
+      break;
+
+    stack_count--;
+    mpz_set( d, stack[stack_count] );
+
+    if ( BPSW( d ) ) {
+      mpz_set( q[*q_count], d );
+      (*q_count)++;
+      while ( mpz_divisible_p( R, d ) ) {
+        mpz_divexact( R, R, d );
+        mpz_mul( F, F, d );
+      }
+      continue;
+    }
+
+    if ( stack_count + 2 > CERTIFY_MAX_FACTORS || !Brent_Rho( d, stack[stack_count] ) )
+      continue;
+    mpz_divexact( stack[stack_count + 1], d, stack[stack_count] );
+    stack_count += 2;
+  }
+
+  int retval = mpz_cmp( F2, n ) > 0;
+
+  mpz_clear( F2 );
+  for ( i = 0; i < CERTIFY_MAX_FACTORS; i++ )
+    mpz_clear( stack[i] );
+  mpz_clears( R, d, NULL );
+
+  return retval;
+}
+
+// Brent's rho with a bounded number of steps.  Returns 1 with a non-trivial
+// factor of n in factor.
+static int Brent_Rho( mpz_t n, mpz_t factor ) {
+  mpz_t x, y, ys, q, t;
+  mpz_inits( x, y, ys, q, t, NULL );
+
+  int found = 0;
+  unsigned long c;
+  for ( c = 1; c < 4 && !found; c++ ) {
+    mpz_set_ui( y, 2 );
+    mpz_set_ui( q, 1 );
+    mpz_set_ui( factor, 1 );
+    unsigned long r = 1, k, i, steps = 0;
+
+    while ( mpz_cmp_ui( factor, 1 ) == 0 && steps < CERTIFY_RHO_LIMIT ) {
+      mpz_set( x, y );
+      for ( i = 0; i < r; i++ ) {
+        mpz_mul( y, y, y );
+        mpz_add_ui( y, y, c );
+        mpz_mod( y, y, n );
+      }
+      for ( k = 0; k < r && mpz_cmp_ui( factor, 1 ) == 0; k += 128 ) {
+        mpz_set( ys, y );
+        for ( i = 0; i < 128 && i < r - k; i++ ) {
+          mpz_mul( y, y, y );
+          mpz_add_ui( y, y, c );
+          mpz_mod( y, y, n );
+          mpz_sub( t, x, y );
+          mpz_mul( q, q, t );
+          mpz_mod( q, q, n );
+        }
+        steps += i;
+        mpz_gcd( factor, q, n );
+      }
+      r <<= 1;
+    }
+
+    if ( mpz_cmp( factor, n ) == 0 ) {
+      do {
+        mpz_mul( ys, ys, ys );
+        mpz_add_ui( ys, ys, c );
+        mpz_mod( ys, ys, n );
+        mpz_sub( t, x, ys );
+        mpz_gcd( factor, t, n );
+      } while ( mpz_cmp_ui( factor, 1 ) == 0 );
+    }
+
+    found = mpz_cmp_ui( factor, 1 ) > 0 && mpz_cmp( factor, n ) < 0;
+  }
+
+  mpz_clears( x, y, ys, q, t, NULL );
+
+  return found;
+}
+
+static uint64_t mulmod64( uint64_t a, uint64_t b, uint64_t n ) {
+  return (uint64_t) ((unsigned __int128) a * b % n);
+}
+
+static uint64_t powmod64( uint64_t base, uint64_t e, uint64_t n ) {
+  uint64_t result = 1;
+  base %= n;
+  while ( e > 0 ) {
+    if ( e & 1 )
+      result = mulmod64( result, base, n );
+    base = mulmod64( base, base, n );
+    e >>= 1;
+  }
+  return result;
+}
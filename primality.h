@@ -0,0 +1,28 @@
+/* Public Domain.  See the LICENSE file.                                     */
+
+/* Primality tests, see primality.c                                          */
+
+#ifndef PRIMALITY_H
+#define PRIMALITY_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <gmp.h>
+
+// Temporaries for the tests above 64 bits, plus the last number tested
+struct prime_scratch {
+mpz_t           d, x, n_minus_1, D_z, U, V, Qk, t;
+mpz_t           last_n;
+char            last_status;
+};
+
+void Init_Prime_Scratch( struct prime_scratch* );
+void Clear_Prime_Scratch( struct prime_scratch* );
+char Prime_Status( mpz_t );
+char Prime_Status_Scratch( mpz_t, struct prime_scratch* );
+int Is_Prime_U64( uint64_t );
+int BPSW( mpz_t );
+int BPSW_Scratch( mpz_t, struct prime_scratch* );
+int Prime_Certify( mpz_t, FILE* );
+
+#endif
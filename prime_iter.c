@@ -0,0 +1,291 @@
+/* Public Domain.  See the LICENSE file.                                     */
+
+/* A prime iterator, for programs that want primes one at a time in order    */
+/* (or in reverse) without holding a bitmap of the whole range or parsing    */
+/* the output of prime_range.                                                */
+/*                                                                           */
+/*   struct prime_iter it;                                                   */
+/*   prime_iter_init( &it, 1000000000000 );                                  */
+/*   uint64_t p = prime_iter_next( &it );      --> 1000000000039             */
+/*   p = prime_iter_prev( &it );               --> 1000000000039             */
+/*   p = prime_iter_prev( &it );               --> 999999999989              */
+/*   prime_iter_clear( &it );                                                */
+/*                                                                           */
+/* Only one segment of PRIME_ITER_SEGMENT bytes (one per odd number, so      */
+/* 2 x PRIME_ITER_SEGMENT numbers) is sieved at a time, when the cursor      */
+/* leaves the last one.  The segment starts as a copy of a repeating pattern */
+/* with the multiples of 3 to 13 already out, and is then crossed off with   */
+/* the other odd primes up to its square root.  These are kept in a table    */
+/* that is extended, by sieving the numbers above the table with the primes  */
+/* already in it, each time the iterator reaches numbers past the square of  */
+/* the table's limit.  Memory is the segment plus the primes up to sqrt of   */
+/* the highest number reached.                                               */
+/*                                                                           */
+/* One iterator per thread; iterators share nothing.                         */
+
+/* No dependencies.  Linked into the programs that use it, eg.               */
+/*   cc -O2 -DFACTOR_NO_MAIN ecm.c prime_iter.c factor_infos.c primality.c   */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "prime_iter.h"
+
+#define PRIME_ITER_FIRST_LIMIT  1024   // the base prime table starts with a simple sieve to here
+
+static void Sieve_Odd( struct prime_iter*, uint64_t, uint64_t );
+static void Sieve_Segment( struct prime_iter*, uint64_t );
+static void Extend_Base( struct prime_iter*, uint64_t );
+static long Find_Position( struct prime_iter*, uint64_t );
+static uint64_t isqrt64( uint64_t );
+
+// next() will return the first prime >= start
+void prime_iter_init( struct prime_iter* it, uint64_t start ) {
+  memset( it, 0, sizeof(struct prime_iter) );
+  it->segment = (uint8_t*) malloc( PRIME_ITER_SEGMENT );
+  it->offsets = (uint16_t*) malloc( PRIME_ITER_SEGMENT * sizeof(uint16_t) );
+  if ( it->segment == NULL || it->offsets == NULL ) {
+    fprintf( stderr, "Error: Failed to allocate memory. Aborting.\n\n" );
+    exit( 1 );
+  }
+  it->cursor = start;
+
+  // odd number 2i + 1 is at pattern[i mod PRIME_ITER_PRESIEVE]
+  it->pattern = (uint8_t*) malloc( PRIME_ITER_PRESIEVE );
+  if ( it->pattern == NULL ) {
+    fprintf( stderr, "Error: Failed to allocate memory. Aborting.\n\n" );
+    exit( 1 );
+  }
+  uint64_t i;
+  for ( i = 0; i < PRIME_ITER_PRESIEVE; i++ ) {
+    uint64_t n = 2 * i + 1;
+    it->pattern[i] = n % 3 && n % 5 && n % 7 && n % 11 && n % 13;
+  }
+}
+
+// The first prime >= the cursor, or 0 past PRIME_ITER_MAX
+uint64_t prime_iter_next( struct prime_iter* it ) {
+  if ( it->cursor <= 2 ) {
+    it->cursor = 3;
+    return 2;
+  }
+
+  for (;;) {
+    if ( it->cursor > PRIME_ITER_MAX )
+      return 0;
+    if ( it->cursor < it->lo || it->cursor >= it->hi ) {
+      Sieve_Segment( it, it->cursor & ~1ull );
+      it->position = Find_Position( it, it->cursor );
+    }
+
+    if ( it->position < it->offset_count ) {
+      uint64_t p = it->lo + 2 * (uint64_t) it->offsets[it->position++] + 1;
+      it->cursor = p + 1;
+      return p;
+    }
+    it->cursor = it->hi;
+  }
+}
+
+// The last prime < the cursor, or 0 if there is none
+uint64_t prime_iter_prev( struct prime_iter* it ) {
+  if ( it->cursor > PRIME_ITER_MAX )
+    prime_iter_skip_to( it, PRIME_ITER_MAX );
+  if ( it->cursor <= 2 )
+    return 0;
+
+  for (;;) {
+    if ( it->cursor <= 3 ) {
+      it->cursor = 2;
+      return 2;
+    }
+    if ( it->cursor <= it->lo || it->cursor > it->hi ) {
+      uint64_t span = 2 * (uint64_t) PRIME_ITER_SEGMENT;
+      uint64_t top = (it->cursor + 1) & ~1ull;
+      Sieve_Segment( it, top > span ? top - span : 0 );
+      it->position = Find_Position( it, it->cursor );
+    }
+
+    if ( it->position > 0 ) {
+      uint64_t p = it->lo + 2 * (uint64_t) it->offsets[--it->position] + 1;
+      it->cursor = p;
+      return p;
+    }
+
+    // below every odd prime, only 2 is left
+    if ( it->lo == 0 ) {
+      it->cursor = 2;
+      return 2;
+    }
+    it->cursor = it->lo;
+  }
+}
+
+// Move the cursor.  The segment is kept, in case x is in it.
+void prime_iter_skip_to( struct prime_iter* it, uint64_t x ) {
+  it->cursor = x;
+  if ( x >= it->lo && x <= it->hi && it->lo != it->hi )
+    it->position = Find_Position( it, x );
+}
+
+void prime_iter_clear( struct prime_iter* it ) {
+  free( it->segment );
+  free( it->offsets );
+  free( it->pattern );
+  free( it->base_primes );
+  memset( it, 0, sizeof(struct prime_iter) );
+}
+
+// Sieve the segment starting at lo (even)
+static void Sieve_Segment( struct prime_iter* it, uint64_t lo ) {
+  uint64_t hi = lo + 2 * (uint64_t) PRIME_ITER_SEGMENT;
+  Extend_Base( it, isqrt64( hi - 1 ) );
+  Sieve_Odd( it, lo, hi );
+  it->lo = lo;
+  it->hi = hi;
+
+  // list where the primes are, without branching on each byte
+  long i, count = PRIME_ITER_SEGMENT, n = 0;
+  for ( i = 0; i < count; i++ ) {
+    it->offsets[n] = (uint16_t) i;
+    n += it->segment[i];
+  }
+  it->offset_count = n;
+}
+
+// How many primes in the segment are below x
+static long Find_Position( struct prime_iter* it, uint64_t x ) {
+  long low = 0, high = it->offset_count;
+  while ( low < high ) {
+    long middle = (low + high) / 2;
+    if ( it->lo + 2 * (uint64_t) it->offsets[middle] + 1 < x )
+      low = middle + 1;
+    else
+      high = middle;
+  }
+  return low;
+}
+
+// Mark the odd numbers in lo .. hi-1 (lo even, at most PRIME_ITER_SEGMENT of
+// them) that are prime.  The table must hold the primes up to sqrt(hi).
+static void Sieve_Odd( struct prime_iter* it, uint64_t lo, uint64_t hi ) {
+  uint64_t count = (hi - lo) / 2;
+  uint64_t offset = (lo / 2) % PRIME_ITER_PRESIEVE;
+  uint64_t done = 0;
+  while ( done < count ) {
+    uint64_t length = PRIME_ITER_PRESIEVE - offset;
+    if ( length > count - done )
+      length = count - done;
+    memcpy( it->segment + done, it->pattern + offset, length );
+    done += length;
+    offset = 0;
+  }
+
+  // the pattern has 3 to 13 themselves out, and 1 in
+  if ( lo < 14 ) {
+    uint64_t q;
+    for ( q = lo + 1; q < 14 && q < hi; q += 2 )
+      it->segment[(q - lo - 1) / 2] = q != 1 && q != 9;
+  }
+
+  // base_primes[0 .. 4] are 3 to 13, already done
+  long k;
+  for ( k = 5; k < it->base_count; k++ ) {
+    uint64_t p = it->base_primes[k];
+    if ( p * p >= hi )
+      break;
+
+    // first odd multiple of p that is > lo and not below p^2
+    uint64_t m = (lo / p + 1) * p;
+    if ( m < p * p )
+      m = p * p;
+    if ( (m & 1) == 0 )
+      m += p;
+
+    uint64_t j;
+    for ( j = (m - lo - 1) / 2; j < count; j += p )
+      it->segment[j] = 0;
+  }
+}
+
+// Make the table hold every odd prime <= need
+static void Extend_Base( struct prime_iter* it, uint64_t need ) {
+  if ( it->base_limit >= need )
+    return;
+
+  if ( it->base_limit == 0 ) {
+    uint8_t composite[PRIME_ITER_FIRST_LIMIT + 1];
+    memset( composite, 0, sizeof(composite) );
+    uint64_t i, j;
+    it->base_capacity = 256;
+    it->base_primes = (uint32_t*) malloc( it->base_capacity * sizeof(uint32_t) );
+    if ( it->base_primes == NULL ) {
+      fprintf( stderr, "Error: Failed to allocate memory. Aborting.\n\n" );
+      exit( 1 );
+    }
+    for ( i = 3; i <= PRIME_ITER_FIRST_LIMIT; i += 2 ) {
+      if ( composite[i] )
+        continue;
+      it->base_primes[it->base_count++] = (uint32_t) i;
+      for ( j = i * i; j <= PRIME_ITER_FIRST_LIMIT; j += 2 * i )
+        composite[j] = 1;
+    }
+    it->base_limit = PRIME_ITER_FIRST_LIMIT;
+  }
+
+  // Sieving above the table with the primes in it finds the primes up to
+  // the square of its limit.  Doubling each time keeps the steps few.
+  while ( it->base_limit < need ) {
+    uint64_t limit = need > 2 * it->base_limit ? need : 2 * it->base_limit;
+    if ( limit > it->base_limit * it->base_limit )
+      limit = it->base_limit * it->base_limit;
+    if ( limit > 0xFFFFFFFFull )
+      limit = 0xFFFFFFFFull;
+
+    uint64_t lo;
+    for ( lo = (it->base_limit + 1) & ~1ull; lo <= limit; lo += 2 * (uint64_t) PRIME_ITER_SEGMENT ) {
+      uint64_t hi = lo + 2 * (uint64_t) PRIME_ITER_SEGMENT;
+      if ( hi > limit + 1 )
+        hi = (limit + 2) & ~1ull;
+      Sieve_Odd( it, lo, hi );
+
+      uint64_t i, count = (hi - lo) / 2;
+      for ( i = 0; i < count; i++ ) {
+        uint64_t p = lo + 2 * i + 1;
+        if ( !it->segment[i] || p <= it->base_limit || p > limit )
+          continue;
+        if ( it->base_count == it->base_capacity ) {
+          uint32_t* grown = (uint32_t*) realloc( it->base_primes, 2 * it->base_capacity * sizeof(uint32_t) );
+          if ( grown == NULL ) {
+            fprintf( stderr, "Error: Failed to allocate memory. Aborting.\n\n" );
+            exit( 1 );
+          }
+          it->base_primes = grown;
+          it->base_capacity *= 2;
+        }
+        it->base_primes[it->base_count++] = (uint32_t) p;
+      }
+    }
+    it->base_limit = limit;
+  }
+
+  // the segment was used as scratch
+  it->lo = it->hi = 0;
+}
+
+// Newton's method from a power of 2 above the root
+static uint64_t isqrt64( uint64_t n ) {
+  if ( n < 2 )
+    return n;
+
+  uint64_t r = 1ull << ((65 - __builtin_clzll( n )) / 2);
+  for (;;) {
+    uint64_t next = (r + n / r) / 2;
+    if ( next >= r )
+      return r;
+    r = next;
+  }
+}
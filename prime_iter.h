@@ -0,0 +1,45 @@
+/* Public Domain.  See the LICENSE file.                                     */
+
+/* Prime iterator over a lazily sieved segment, see prime_iter.c             */
+
+#ifndef PRIME_ITER_H
+#define PRIME_ITER_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PRIME_ITER_SEGMENT  32768                   // bytes, 1 per odd number
+#define PRIME_ITER_MAX      0xFFFFFFFFFFF00000ull   // next() gives 0 past here
+#define PRIME_ITER_PRESIEVE 15015                   // 3.5.7.11.13
+
+// The iterator sits between two numbers:  next() returns the first prime at
+// or after the cursor, prev() the last one before it, and each moves the
+// cursor past the prime returned, so next() then prev() give the same prime.
+struct prime_iter {
+uint32_t*       base_primes;   // odd primes <= base_limit
+long            base_count;
+long            base_capacity;
+uint64_t        base_limit;
+uint8_t*        segment;       // odd numbers in lo .. hi-1, 1 --> prime
+uint8_t*        pattern;       // odd numbers coprime to 3.5.7.11.13, repeating
+uint16_t*       offsets;       // indexes of the primes in segment, in order
+long            offset_count;
+uint64_t        lo, hi;        // lo is even.  lo == hi --> nothing sieved yet
+uint64_t        cursor;
+long            position;      // offsets[position] is the first prime >= cursor
+};
+
+void prime_iter_init( struct prime_iter*, uint64_t );
+uint64_t prime_iter_next( struct prime_iter* );
+uint64_t prime_iter_prev( struct prime_iter* );
+void prime_iter_skip_to( struct prime_iter*, uint64_t );
+void prime_iter_clear( struct prime_iter* );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
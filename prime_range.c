@@ -5,14 +5,16 @@
 /* Super simple algorithm -- just runs the Sieve of Eratosthenes    */
 /* for the full range from 0 to the last number of the range.       */
 
-/* No dependencies.                                                 */
-/* On linux, try:  cc prime_range.c -o prime_range                  */
+/* On linux, try:  cc prime_range.c stats.c -o prime_range          */
+/* --stats (or --stats=json) reports the work done, see stats.c.    */
 
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 
+#include "stats.h"
+
 unsigned int  mask[32] = {0x00000001,0x00000002,0x00000004,0x00000008,
                           0x00000010,0x00000020,0x00000040,0x00000080,
                           0x00000100,0x00000200,0x00000400,0x00000800,
@@ -27,8 +29,11 @@ int64_t isqrt( int64_t number );
 
 int main( int argc, char * argv[] ) {
 
+  struct stats stats;
+  Stats_Init( &stats, &argc, argv );
+
   if ( argc != 3 ) {
-    fprintf( stderr, "Usage: prime_range start end\n");
+    fprintf( stderr, "Usage: prime_range [--stats[=json]] start end\n");
     return 1;
   }
 
@@ -67,6 +72,10 @@ int main( int argc, char * argv[] ) {
   array[0] |= mask[0]; // corresponds to the number 0 which is not prime
   array[0] |= mask[1]; // corresponds to the number 1 which is not prime
 
+  Stats_Phase_Start( &stats, "compute primes" );
+  uint64_t sieving_primes = 0;
+  uint64_t writes = 0;
+
   long sqrroot_of_upper_limit = isqrt(end) + 1;
   int64_t quot = 0;
   int64_t rem = 0;
@@ -81,17 +90,36 @@ int main( int argc, char * argv[] ) {
         rem = j & 0x0000001F;
         array[quot] |= mask[rem];
       }
+      if ( stats.enabled ) {
+        sieving_primes++;
+        if ( i + i <= end )
+          writes += (end - i - i) / i + 1;
+      }
     }
   }
 
+  Stats_Phase_Stop( &stats );
+  Stats_Count( &stats, "segments", 1 );
+  Stats_Count( &stats, "sieving primes", sieving_primes );
+  Stats_Count( &stats, "crossing-off writes", writes );
+  Stats_Phase_Start( &stats, "print primes" );
+  uint64_t printed = 0;
+
   // Print out the primes
   for (i = begin; i <= end; i++) {
     quot = i >> 5;
     rem = i & 0x0000001F;
-    if (!(mask[rem] & array[quot]))
+    if (!(mask[rem] & array[quot])) {
       printf( "%ld\n", i );
+      printed++;
+    }
   }
 
+  Stats_Phase_Stop( &stats );
+  Stats_Count( &stats, "primes printed", printed );
+  Stats_Print( &stats, stderr );
+  Stats_Cleanup( &stats );
+
   if ( array != NULL ) {
     free( array );
     array = NULL;
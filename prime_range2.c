@@ -4,14 +4,16 @@
 
 /* Just prime_range.c, but won't compute primes if not necessary    */
 
-/* No dependencies.                                                 */
-/* On linux, try:  cc prime_range2.c -o prime_range2                */
+/* On linux, try:  cc prime_range2.c stats.c -o prime_range2        */
+/* --stats (or --stats=json) reports the work done, see stats.c.    */
 
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 
+#include "stats.h"
+
 unsigned int  mask[32] = {0x00000001,0x00000002,0x00000004,0x00000008,
                           0x00000010,0x00000020,0x00000040,0x00000080,
                           0x00000100,0x00000200,0x00000400,0x00000800,
@@ -26,8 +28,11 @@ int64_t isqrt( int64_t number );
 
 int main( int argc, char * argv[] ) {
 
+  struct stats stats;
+  Stats_Init( &stats, &argc, argv );
+
   if ( argc != 3 ) {
-    fprintf( stderr, "Usage: prime_range2 start end\n");
+    fprintf( stderr, "Usage: prime_range2 [--stats[=json]] start end\n");
     return 1;
   }
 
@@ -90,6 +95,11 @@ int main( int argc, char * argv[] ) {
     }
   }
 
+  Stats_Phase_Start( &stats, "compute primes" );
+  uint64_t sieving_primes = 0;
+  uint64_t chunk1_writes = 0;
+  uint64_t chunk2_writes = 0;
+
   int64_t quot = 0;
   int64_t rem = 0;
   int64_t i = 0;
@@ -106,6 +116,11 @@ int main( int argc, char * argv[] ) {
         rem = j & 0x0000001F;
         chunk1[quot] |= mask[rem];
       }
+      if ( stats.enabled ) {
+        sieving_primes++;
+        if ( i + i <= chunk1_end )
+          chunk1_writes += (chunk1_end - i - i) / i + 1;
+      }
 
       if ( chunk2 != NULL ) {
         tempz1 = ((chunk2_begin / i) * i) - chunk2_begin; // calculate offset into chunk2
@@ -117,10 +132,22 @@ int main( int argc, char * argv[] ) {
           rem = j & 0x0000001F;
           chunk2[quot] |= mask[rem];
         }
+        if ( stats.enabled && tempz1 <= chunk2_max_offset )
+          chunk2_writes += (chunk2_max_offset - tempz1) / i + 1;
       }
     }
   }
 
+  Stats_Phase_Stop( &stats );
+  Stats_Count( &stats, "segments", chunk2 != NULL ? 2 : 1 );
+  Stats_Count( &stats, "sieving primes", sieving_primes );
+  Stats_Count( &stats, "crossing-off writes", chunk1_writes + chunk2_writes );
+  Stats_Count( &stats, "chunk1 writes", chunk1_writes );
+  Stats_Count( &stats, "chunk2 writes", chunk2_writes );
+  Stats_Count( &stats, "numbers skipped (gap)", gap_size * 32 );
+  Stats_Phase_Start( &stats, "print primes" );
+  uint64_t printed = 0;
+
   // print chunk1
   if ( begin <= chunk1_end ) {
     int64_t print_begin = begin;
@@ -128,8 +155,10 @@ int main( int argc, char * argv[] ) {
     for (i = print_begin; i <= print_end; i++) {
       quot = i >> 5;
       rem = i & 0x0000001F;
-      if (!(mask[rem] & chunk1[quot]))
+      if (!(mask[rem] & chunk1[quot])) {
         printf( "%ld\n", i );
+        printed++;
+      }
     }
   }
 
@@ -142,10 +171,16 @@ int main( int argc, char * argv[] ) {
       rem = i & 0x0000001F;
       if (!(mask[rem] & chunk2[quot])) {
         printf( "%ld\n", j );
+        printed++;
       }
     }
   }
 
+  Stats_Phase_Stop( &stats );
+  Stats_Count( &stats, "primes printed", printed );
+  Stats_Print( &stats, stderr );
+  Stats_Cleanup( &stats );
+
   if ( chunk2 != NULL ) {
     free( chunk2 );
     chunk2 = NULL;
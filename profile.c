@@ -0,0 +1,86 @@
+/* Public Domain.  See the LICENSE file.                                     */
+
+/* The machine profile written by tune (see tune.c).  It holds the settings  */
+/* that are best on this machine, eg. sieve segment sizes that fit its       */
+/* caches, as "key=value" lines ('#' starts a comment):                      */
+/*                                                                           */
+/*   factor_range.segment_size=65536                                         */
+/*   factor.tf_limit=131072                                                  */
+/*                                                                           */
+/* The file is $FACTORING_PROFILE, or else ~/.factoring_profile.  It is read */
+/* the first time a program asks for a setting.  A missing file or key just  */
+/* means the program's own default, so the programs work without one.        */
+
+/* No dependencies.  Linked into the programs, eg.                           */
+/*   cc -O2 factor_range.c stats.c profile.c -lpthread -o factor_range       */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "profile.h"
+
+static struct profile_entry entries[PROFILE_MAX_ENTRIES];
+static int entry_count = 0;
+static int loaded = 0;
+static char path[4096];
+
+static void Profile_Load( void );
+
+// The value of key, or default_value if the profile does not set it
+long Profile_Get( const char* key, long default_value ) {
+  if ( !loaded )
+    Profile_Load();
+
+  int i;
+  for ( i = 0; i < entry_count; i++ )
+    if ( !strcmp( entries[i].key, key ) )
+      return entries[i].value;
+
+  return default_value;
+}
+
+// Where the profile is (or would be)
+const char* Profile_File( void ) {
+  if ( !loaded )
+    Profile_Load();
+  return path;
+}
+
+static void Profile_Load( void ) {
+  loaded = 1;
+
+  const char* env = getenv( "FACTORING_PROFILE" );
+  const char* home = getenv( "HOME" );
+  if ( env != NULL )
+    snprintf( path, sizeof(path), "%s", env );
+  else if ( home != NULL )
+    snprintf( path, sizeof(path), "%s/.factoring_profile", home );
+  else
+    return;
+
+  FILE* f = fopen( path, "r" );
+  if ( f == NULL )
+    return;
+
+  char line[256];
+  while ( fgets( line, sizeof(line), f ) != NULL && entry_count < PROFILE_MAX_ENTRIES ) {
+    line[strcspn( line, "#\n" )] = '\0';
+    char* value = strchr( line, '=' );
+    if ( value == NULL )
+      continue;
+    *value++ = '\0';
+
+    // a bad value is ignored, so the default stays
+    char* end;
+    long number = strtol( value, &end, 10 );
+    if ( end == value || strlen( line ) >= PROFILE_MAX_KEY )
+      continue;
+
+    strcpy( entries[entry_count].key, line );
+    entries[entry_count].value = number;
+    entry_count++;
+  }
+  fclose( f );
+}
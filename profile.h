@@ -0,0 +1,19 @@
+/* Public Domain.  See the LICENSE file.                                     */
+
+/* Machine profile, see profile.c                                            */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#define PROFILE_MAX_ENTRIES  64
+#define PROFILE_MAX_KEY      64
+
+struct profile_entry {
+char            key[PROFILE_MAX_KEY];
+long            value;
+};
+
+long Profile_Get( const char*, long );
+const char* Profile_File( void );
+
+#endif
@@ -6,18 +6,32 @@
 
 /* To compile, the GMP library needs to be already installed.                */
 /* See https://gmplib.org                                                    */
-/* On linux, try:  cc rho.c -lgmp -o rho                                     */
+/* On linux, try:                                                            */
+/*   cc rho.c primality.c stats.c -lgmp -lpthread -o rho                     */
+/* Build with -DFACTOR_NO_MAIN to link Rho() into another program.           */
+/* --stats (or --stats=json) reports the work done, see stats.c.             */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <gmp.h>
 
-void g( mpz_t, mpz_t );
+#include "primality.h"
+#include "rho.h"
+#include "stats.h"
 
+static void g( mpz_t, mpz_t, unsigned long );
+
+// Work done on this thread, for --stats
+__thread struct rho_counts Rho_Counts;
+
+#ifndef FACTOR_NO_MAIN
 int main( int argc , char * argv[] ) {
 
+  struct stats stats;
+  Stats_Init( &stats, &argc, argv );
+
   if ( argc != 2 ) {
-    printf("\nUsage: rho N\n");
+    printf("\nUsage: rho [--stats[=json]] N\n");
     return 1;
   }
 
@@ -32,55 +46,89 @@ int main( int argc , char * argv[] ) {
     return 1;
   }
 
-  if ( mpz_probab_prime_p( n, 30 ) ) {
+  if ( Prime_Status( n ) == 'P' ) {
     printf( "N is a probable prime. Aborting.\n\n" );
     mpz_clear( n );
     return 1;
   }
 
+  mpz_t d;
+  mpz_init( d );
+
+  Stats_Phase_Start( &stats, "rho" );
+  int found = Rho( n, 1, -1, d );
+  Stats_Phase_Stop( &stats );
+  // each iteration is one step of x and two of y, then one gcd
+  Stats_Count( &stats, "iterations", Rho_Counts.iterations );
+  Stats_Count( &stats, "squarings", 3 * Rho_Counts.iterations );
+  Stats_Count( &stats, "gcds", Rho_Counts.iterations );
+
+  if ( !found )
+    printf( "Failure\n" );
+  else
+    gmp_printf( "Found a non-trivial factor: %Zd\n", d );
+
+  Stats_Print( &stats, stderr );
+  Stats_Cleanup( &stats );
+
+  mpz_clear( d );
+  mpz_clear( n );
+
+  return 0;
+ }
+#endif
+
+// Run rho with the polynomial x^2 + c for at most max_iterations steps
+// (no limit if negative).  Returns 1 with d set to a non-trivial factor of n,
+// or 0 on failure.
+int Rho( mpz_t n, unsigned long c, long max_iterations, mpz_t d ) {
+
   mpz_t x;
   mpz_init( x );
   mpz_t y;
   mpz_init( y );
-  mpz_t d;
-  mpz_init( d );
+  mpz_t tempZ1;
+  mpz_init( tempZ1 );
+
+  int retval = Rho_Scratch( n, c, max_iterations, d, x, y, tempZ1 );
+
+  mpz_clear( tempZ1 );
+  mpz_clear( y );
+  mpz_clear( x );
+
+  return retval;
+}
+
+// Rho() with the caller's temporaries x, y and tempZ1
+int Rho_Scratch( mpz_t n, unsigned long c, long max_iterations, mpz_t d, mpz_t x, mpz_t y, mpz_t tempZ1 ) {
 
   mpz_set_ui( d, 1 );
   mpz_set_ui( x, 2 );
   mpz_set( y, x );
 
-
-  mpz_t tempZ1;
-  mpz_init( tempZ1 );
-
+  long iterations = 0;
   while ( !mpz_cmp_ui( d, 1 ) ) {
-    g( x, n );
-    g( y, n );
-    g( y, n );
+    if ( max_iterations >= 0 && iterations >= max_iterations )
+      break;
+    iterations++;
+
+    g( x, n, c );
+    g( y, n, c );
+    g( y, n, c );
 
     mpz_sub( tempZ1, x, y );
     mpz_abs( tempZ1, tempZ1 );
     mpz_gcd( d, tempZ1, n );
   }
 
-  if ( !mpz_cmp( d, n ) )
-    printf( "Failure\n" );
-  else
-    gmp_printf( "Found a non-trivial factor: %Zd\n", d );
-
-  mpz_clear( tempZ1 );
-  mpz_clear( d );
-  mpz_clear( y );
-  mpz_clear( x );
-  mpz_clear( n );
+  Rho_Counts.iterations += iterations;
 
-  return 0;
- }
+  return mpz_cmp_ui( d, 1 ) != 0 && mpz_cmp( d, n ) != 0;
+}
 
-// computes the polynomial in x which will be hard coded to "x^2 + 1" mod n
-void g( mpz_t x, mpz_t n ) {
+// computes the polynomial "x^2 + c" mod n
+static void g( mpz_t x, mpz_t n, unsigned long c ) {
   mpz_mul( x, x, x );
-  mpz_add_ui( x, x, 1 );
+  mpz_add_ui( x, x, c );
   mpz_mod( x, x, n );
 }
-
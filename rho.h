@@ -0,0 +1,21 @@
+/* Public Domain.  See the LICENSE file.                                     */
+
+/* Pollard's Rho, see rho.c                                                  */
+
+#ifndef RHO_H
+#define RHO_H
+
+#include <stdint.h>
+#include <gmp.h>
+
+// Work done by Rho_Scratch() on this thread, for --stats
+struct rho_counts {
+uint64_t        iterations;
+};
+
+extern __thread struct rho_counts Rho_Counts;
+
+int Rho( mpz_t, unsigned long, long, mpz_t );
+int Rho_Scratch( mpz_t, unsigned long, long, mpz_t, mpz_t, mpz_t, mpz_t );
+
+#endif
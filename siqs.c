@@ -0,0 +1,1560 @@
+/* Public Domain.  See the LICENSE file.                                     */
+
+/* Self-Initializing Quadratic Sieve (SIQS).                                 */
+/* https://en.wikipedia.org/wiki/Quadratic_sieve                             */
+/* Contini, "Factoring Integers with the Self-Initializing Quadratic Sieve". */
+
+/* fermat.c looks for a^2 - N == b^2 one a at a time.  The quadratic sieve   */
+/* instead collects many (Ax + b)^2 == A.g(x) (mod N) where g(x) factors     */
+/* over a small factor base, then combines them with linear algebra over     */
+/* GF(2) into X^2 == Y^2 (mod N).                                            */
+/*                                                                           */
+/*   - Knuth-Schroeppel multiplier selection.                                */
+/*   - A = q_1 ... q_s, with the 2^(s-1) b values walked in Gray code order  */
+/*     so each new polynomial costs one add per factor base prime.           */
+/*   - Sieving is done a 32 KiB block at a time with 1 byte log approx.      */
+/*     Primes below SIQS_SMALL_PRIME are not sieved at all (the threshold    */
+/*     is lowered by their expected contribution instead).                   */
+/*   - Single large prime variation.  Two partials with the same large       */
+/*     prime are combined into one relation.                                 */
+/*   - Singleton removal, then block Lanczos on the sparse matrix (dense    */
+/*     Gaussian elimination when it is small).                               */
+/*   - Each thread sieves its own A values.                                  */
+
+/* To compile, the GMP library needs to be already installed.                */
+/* See https://gmplib.org                                                    */
+/* On linux, try:                                                            */
+/*   cc -O2 siqs.c factor_infos.c primality.c -lgmp -lm -lpthread -o siqs    */
+/* Build with -DFACTOR_NO_MAIN to link SIQS() into another program.          */
+
+/* Some test numbers:                                                        */
+/* siqs 1000000016000000063                  --> 1000000007.1000000009       */
+/* siqs 61748077010482815902444783236944717198361852023577                   */
+/*         --> 6263457312334903264362547.9858465370056821370479491     ~1s   */
+/* siqs 494539303040722775382041974746954004201084603897061173672861         */
+/*         --> 587320478161116480663150048353.842026323667635606410750824637 */
+/*                                                    ~7s on a single core   */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <gmp.h>
+
+#include "factor_infos.h"
+#include "siqs.h"
+
+#define SIQS_BLOCK        32768
+#define SIQS_SMALL_PRIME  40
+#define SIQS_MAX_A_PRIMES 20
+#define SIQS_EXCESS       64
+#define SIQS_MAX_FACTORS  256
+#define SIQS_FUDGE        8.0    // extra bits of slack in the sieve threshold
+#define SIQS_LANCZOS_MIN  1000   // columns.  Smaller matrices use dense elimination
+#define SIQS_LANCZOS_TRIES 4
+
+// Parameters by size of N in bits.  Factor base size and blocks per side
+// (the sieve interval is [-M, M) with M = blocks * SIQS_BLOCK) are linearly
+// interpolated between entries.
+struct siqs_params {
+int             bits;
+long            fb_size;
+int             blocks;
+int             lp_mult;
+};
+
+static const struct siqs_params siqs_table[] = { {  64,    100,  1,  20 },
+                                                 { 128,    450,  1,  30 },
+                                                 { 183,   2000,  2,  40 },
+                                                 { 200,   3000,  2,  50 },
+                                                 { 212,   5400,  3,  60 },
+                                                 { 233,  10000,  4,  70 },
+                                                 { 249,  27000,  6,  80 },
+                                                 { 266,  50000,  8,  90 },
+                                                 { 283,  55000, 10, 100 },
+                                                 { 298,  60000, 12, 110 },
+                                                 { 332, 100000, 16, 120 } };
+static const int siqs_table_count = sizeof(siqs_table) / sizeof(siqs_table[0]);
+
+// Odd squarefree Knuth-Schroeppel candidates
+static const unsigned long siqs_multipliers[] = { 1, 3, 5, 7, 11, 13, 15, 17, 19, 21, 23, 29, 31, 33, 35,
+                                                  37, 39, 41, 43, 47, 51, 53, 55, 57, 59, 61, 65, 67, 69, 71, 73 };
+static const int siqs_multipliers_count = sizeof(siqs_multipliers) / sizeof(siqs_multipliers[0]);
+
+// Factor base.  Index 0 stands for -1 and index 1 for 2.  "special" entries
+// (-1, 2 and the primes dividing the multiplier) are never sieved and are
+// checked with mpz division instead.
+struct siqs_fb {
+long            size;
+uint32_t*       prime;
+uint32_t*       sqrtkN;
+uint8_t*        logp;
+char*           special;
+long            small_end;     // first index that is sieved
+long            a_lo, a_hi;    // index range the A primes are drawn from
+int             s;             // number of primes in A
+};
+
+// One relation:  Y^2 == (product of factor base primes) * large_prime^2 (mod N)
+// for a full relation large_prime is 1.
+struct siqs_relation {
+mpz_t           Y;
+uint32_t*       factors;       // factor base indices, repeated once per power
+int             count;
+unsigned long   large_prime;
+};
+
+// Shared between the sieving threads
+struct siqs_job {
+mpz_t           n;
+mpz_t           kn;
+unsigned long   k;
+struct siqs_fb  fb;
+long            M;
+int             blocks;
+uint8_t         sieve_init;
+unsigned long   lp_max;
+double          log2_target_A;
+
+struct siqs_relation* relations;
+long            relations_count;
+long            relations_alloc;
+long            fulls;
+long            cycles;
+long            needed;
+
+unsigned long*  lp_keys;       // large prime --> first relation with it
+long*           lp_first;
+long            lp_alloc;
+long            lp_count;
+
+uint64_t*       used_A;        // low limb of every A tried so far
+long            used_A_alloc;
+long            used_A_count;
+
+volatile int    done;
+pthread_mutex_t lock;
+};
+
+// The GF(2) matrix, one column per relation set.  Column i has a 1 in the
+// rows entries[col_start[i]] .. entries[col_start[i+1] - 1].
+struct siqs_matrix {
+long            rows;
+long            cols;
+long*           col_start;
+uint32_t*       entries;
+};
+
+// Per thread polynomial and sieve state
+struct siqs_poly {
+struct siqs_job* job;
+uint64_t        rng;
+int             s;
+long            q_idx[SIQS_MAX_A_PRIMES];
+mpz_t           A, b, c;
+mpz_t           B[SIQS_MAX_A_PRIMES];
+mpz_t           tmp1, tmp2, Y, g;
+uint32_t*       soln1;
+uint32_t*       soln2;
+uint32_t*       next1;
+uint32_t*       next2;
+uint32_t*       Bainv2;        // s rows of fb.size
+char*           in_A;
+uint8_t*        sieve;
+};
+
+static unsigned long Choose_Multiplier( mpz_t );
+static int Build_Factor_Base( struct siqs_job*, mpz_t );
+static void* SIQS_Worker( void* );
+static int New_A( struct siqs_poly* );
+static void Sieve_Polynomial( struct siqs_poly* );
+static void Check_Candidate( struct siqs_poly*, long );
+static void Save_Relation( struct siqs_job*, mpz_t, uint32_t*, int, unsigned long );
+static int Lookup_Large_Prime( struct siqs_job*, unsigned long, long );
+static int Find_Factor( struct siqs_job*, mpz_t );
+static uint64_t* Dense_Dependencies( struct siqs_matrix* );
+static uint64_t* Block_Lanczos( struct siqs_matrix*, uint64_t* );
+static uint64_t* Combine_Cofactors( struct siqs_matrix*, uint64_t*, uint64_t* );
+static int Find_Nonsingular_Sub( uint64_t*, int*, int*, int, uint64_t* );
+static void Mul_B( struct siqs_matrix*, uint64_t*, uint64_t* );
+static void Mul_Sym( struct siqs_matrix*, uint64_t*, uint64_t*, uint64_t* );
+static void Mul_64xN_Nx64( uint64_t*, uint64_t*, uint64_t*, long );
+static void Mul_Nx64_64x64_Acc( uint64_t*, uint64_t*, uint64_t*, long );
+static void Mul_64x64_64x64( uint64_t*, uint64_t*, uint64_t* );
+static uint32_t sqrt_modp( uint32_t, uint32_t );
+static uint32_t inv_modp( uint32_t, uint32_t );
+static uint32_t pow_modp( uint32_t, uint32_t, uint32_t );
+static uint64_t next_random( uint64_t* );
+
+#ifndef FACTOR_NO_MAIN
+int main( int argc, char * argv[] ) {
+
+  int threads = (int) sysconf( _SC_NPROCESSORS_ONLN );
+
+  int argi = 1;
+  if ( argc == 4 && !strcmp( argv[1], "-t" ) ) {
+    threads = atoi( argv[2] );
+    argi = 3;
+  }
+
+  if ( argi != argc - 1 ) {
+    printf( "\nUsage: siqs [-t threads] n\n\n" );
+    return 1;
+  }
+
+  if ( threads < 1 )
+    threads = 1;
+
+  mpz_t n;
+  mpz_init_set_str( n, argv[argi], 10 );
+
+  if ( mpz_cmp_ui( n, 100 ) < 0 ) {
+    printf( "\nLower bound on N is currently 100. Aborting.\n\n" );
+    mpz_clear( n );
+    return 1;
+  }
+
+  struct factor_infos Factor_Infos;
+  Init_Factor_Infos( &Factor_Infos );
+
+  SIQS( n, threads, &Factor_Infos );
+
+  Print_Factor_Infos( &Factor_Infos );
+
+  Cleanup_Factor_Infos( &Factor_Infos );
+  mpz_clear( n );
+
+  return 0;
+}
+#endif
+
+// Split n with the quadratic sieve.  Returns 'F' and adds the two pieces to
+// Factor_Infos if a factor was found, otherwise adds n itself and returns its
+// status ('C' on failure, 'P' if n is prime).
+char SIQS( mpz_t n, int threads, struct factor_infos* Factor_Infos ) {
+  if ( Factor_Infos == NULL )
+    return 'N';
+
+  char n_status = quickprimecheck( n );
+  if ( n_status != 'C' ) {
+    if ( n_status == 'P' )
+      AddFactorInfo( Factor_Infos, n, 1, 'P' );
+    return n_status;
+  }
+
+  mpz_t factor;
+  mpz_init( factor );
+
+  // The sieve needs N to be odd and not a perfect square
+  if ( mpz_even_p( n ) )
+    mpz_set_ui( factor, 2 );
+  else if ( mpz_perfect_square_p( n ) )
+    mpz_sqrt( factor, n );
+
+  if ( mpz_cmp_ui( factor, 0 ) != 0 ) {
+    Add_Split( Factor_Infos, n, factor );
+    mpz_clear( factor );
+    return 'F';
+  }
+
+  struct siqs_job job;
+  memset( &job, 0, sizeof(job) );
+  mpz_init_set( job.n, n );
+  mpz_init( job.kn );
+  job.k = Choose_Multiplier( n );
+  mpz_mul_ui( job.kn, n, job.k );
+  pthread_mutex_init( &job.lock, NULL );
+
+  // Interpolate the parameters
+  int bits = (int) mpz_sizeinbase( n, 2 );
+  int row = 0;
+  while ( row < siqs_table_count - 2 && bits > siqs_table[row+1].bits )
+    row++;
+  double frac = (double) (bits - siqs_table[row].bits) / (siqs_table[row+1].bits - siqs_table[row].bits);
+  if ( frac < 0.0 )
+    frac = 0.0;
+  long fb_size = siqs_table[row].fb_size + (long) (frac * (siqs_table[row+1].fb_size - siqs_table[row].fb_size));
+  job.blocks = siqs_table[row].blocks + (int) (frac * (siqs_table[row+1].blocks - siqs_table[row].blocks) + 0.5);
+  int lp_mult = siqs_table[row].lp_mult + (int) (frac * (siqs_table[row+1].lp_mult - siqs_table[row].lp_mult));
+  job.M = (long) job.blocks * SIQS_BLOCK;
+
+  // A should be close to sqrt(2kN)/M
+  double log2_kn = mpz_sizeinbase( job.kn, 2 );
+  job.log2_target_A = (log2_kn + 1.0) / 2.0 - log2( (double) job.M );
+
+  job.fb.size = fb_size;
+  if ( Build_Factor_Base( &job, factor ) ) {
+    Add_Split( Factor_Infos, n, factor );
+    n_status = 'F';
+    goto cleanup;
+  }
+
+  uint32_t pmax = job.fb.prime[job.fb.size - 1];
+  job.lp_max = (unsigned long) pmax * lp_mult;
+  job.needed = job.fb.size + SIQS_EXCESS;
+
+  // g(x) = A.x^2 + 2.b.x + c is at most about M.sqrt(kN/2) over the interval.
+  // Candidates must have all but a large prime's worth of that accounted for.
+  double log2_gmax = log2( (double) job.M ) + (log2_kn - 1.0) / 2.0;
+  double small_fudge = 0.0;
+  long i;
+  for ( i = 1; i < job.fb.small_end; i++ )
+    if ( !job.fb.special[i] )
+      small_fudge += 2.0 * log2( job.fb.prime[i] ) / (job.fb.prime[i] - 1);
+  double threshold = log2_gmax - log2( (double) job.lp_max ) - small_fudge - SIQS_FUDGE;
+  if ( threshold < 10.0 )
+    threshold = 10.0;
+
+  // Keep the byte counters clear of overflow by scaling the logs if needed.
+  // A byte with its top bit set is a candidate.
+  double scale = threshold > 100.0 ? 100.0 / threshold : 1.0;
+  for ( i = 0; i < job.fb.size; i++ )
+    job.fb.logp[i] = (uint8_t) (log2( job.fb.prime[i] ) * scale + 0.5);
+  job.sieve_init = (uint8_t) (128 - (int) (threshold * scale + 0.5));
+
+  job.relations_alloc = job.needed * 2;
+  job.relations = (struct siqs_relation*) calloc( job.relations_alloc, sizeof(struct siqs_relation) );
+  job.lp_alloc = 1024;
+  job.lp_keys = (unsigned long*) calloc( job.lp_alloc, sizeof(unsigned long) );
+  job.lp_first = (long*) calloc( job.lp_alloc, sizeof(long) );
+  job.used_A_alloc = 1024;
+  job.used_A = (uint64_t*) calloc( job.used_A_alloc, sizeof(uint64_t) );
+
+  pthread_t* workers = (pthread_t*) calloc( threads, sizeof(pthread_t) );
+  for ( i = 0; i < threads; i++ )
+    pthread_create( &workers[i], NULL, SIQS_Worker, &job );
+  for ( i = 0; i < threads; i++ )
+    pthread_join( workers[i], NULL );
+  free( workers );
+
+  if ( Find_Factor( &job, factor ) ) {
+    Add_Split( Factor_Infos, n, factor );
+    n_status = 'F';
+  }
+  else
+    AddFactorInfo( Factor_Infos, n, 1, 'C' );
+
+  for ( i = 0; i < job.relations_count; i++ ) {
+    mpz_clear( job.relations[i].Y );
+    free( job.relations[i].factors );
+  }
+  free( job.relations );
+  free( job.lp_keys );
+  free( job.lp_first );
+  free( job.used_A );
+
+cleanup:
+  free( job.fb.prime );
+  free( job.fb.sqrtkN );
+  free( job.fb.logp );
+  free( job.fb.special );
+  pthread_mutex_destroy( &job.lock );
+  mpz_clear( job.kn );
+  mpz_clear( job.n );
+  mpz_clear( factor );
+
+  return n_status;
+}
+
+// Knuth-Schroeppel:  pick k so that kN has many small quadratic residues.
+static unsigned long Choose_Multiplier( mpz_t n ) {
+  unsigned long best_k = 1;
+  double best_score = -1e9;
+
+  int m;
+  for ( m = 0; m < siqs_multipliers_count; m++ ) {
+    unsigned long k = siqs_multipliers[m];
+    double score = -0.5 * log( (double) k );
+
+    unsigned long kn_mod8 = (mpz_fdiv_ui( n, 8 ) * k) & 7;
+    if ( kn_mod8 == 1 )
+      score += 2.0 * log( 2.0 );
+    else if ( kn_mod8 == 5 )
+      score += log( 2.0 );
+    else
+      score += 0.5 * log( 2.0 );
+
+    uint32_t p;
+    for ( p = 3; p < 2000; p += 2 ) {
+      uint32_t d;
+      for ( d = 3; d * d <= p && p % d != 0; d += 2 )
+        ;
+      if ( d * d <= p )
+        continue;
+
+      uint32_t kn_modp = (uint32_t) ((mpz_fdiv_ui( n, p ) * (k % p)) % p);
+      if ( kn_modp == 0 )
+        score += log( (double) p ) / p;
+      else if ( pow_modp( kn_modp, (p - 1) / 2, p ) == 1 )
+        score += 2.0 * log( (double) p ) / (p - 1);
+    }
+
+    if ( score > best_score ) {
+      best_score = score;
+      best_k = k;
+    }
+  }
+
+  return best_k;
+}
+
+// Returns 1 (with factor set) if a factor base prime happens to divide N.
+static int Build_Factor_Base( struct siqs_job* job, mpz_t factor ) {
+  struct siqs_fb* fb = &job->fb;
+  fb->prime = (uint32_t*) calloc( fb->size, sizeof(uint32_t) );
+  fb->sqrtkN = (uint32_t*) calloc( fb->size, sizeof(uint32_t) );
+  fb->logp = (uint8_t*) calloc( fb->size, sizeof(uint8_t) );
+  fb->special = (char*) calloc( fb->size, sizeof(char) );
+
+  fb->prime[0] = 1;
+  fb->special[0] = 1;
+  fb->prime[1] = 2;
+  fb->special[1] = 1;
+
+  long count = 2;
+  uint32_t p;
+  for ( p = 3; count < fb->size; p += 2 ) {
+    uint32_t d;
+    for ( d = 3; d * d <= p && p % d != 0; d += 2 )
+      ;
+    if ( d * d <= p )
+      continue;
+
+    if ( mpz_divisible_ui_p( job->n, p ) ) {
+      mpz_set_ui( factor, p );
+      return 1;
+    }
+
+    uint32_t kn_modp = (uint32_t) mpz_fdiv_ui( job->kn, p );
+    if ( kn_modp == 0 ) {
+      fb->prime[count] = p;
+      fb->special[count] = 1;
+      count++;
+    }
+    else if ( pow_modp( kn_modp, (p - 1) / 2, p ) == 1 ) {
+      fb->prime[count] = p;
+      fb->sqrtkN[count] = sqrt_modp( kn_modp, p );
+      count++;
+    }
+  }
+
+  fb->small_end = 2;
+  while ( fb->small_end < fb->size && fb->prime[fb->small_end] < SIQS_SMALL_PRIME )
+    fb->small_end++;
+
+  // Choose s and the range of primes A is built from, aiming for A primes
+  // around 2000 (or as large as the factor base allows).
+  double log2_target = job->log2_target_A;
+  int s = (int) (log2_target / log2( 2000.0 ) + 0.5);
+  if ( s < 2 )
+    s = 2;
+  if ( s > SIQS_MAX_A_PRIMES )
+    s = SIQS_MAX_A_PRIMES;
+  double q_size = pow( 2.0, log2_target / s );
+  while ( s < SIQS_MAX_A_PRIMES && q_size > fb->prime[fb->size - 1] / 4.0 ) {
+    s++;
+    q_size = pow( 2.0, log2_target / s );
+  }
+
+  fb->a_lo = fb->small_end;
+  while ( fb->a_lo < fb->size - 1 && fb->prime[fb->a_lo] < q_size / 2.0 )
+    fb->a_lo++;
+  fb->a_hi = fb->a_lo;
+  while ( fb->a_hi < fb->size - 1 && fb->prime[fb->a_hi] < q_size * 2.0 )
+    fb->a_hi++;
+  while ( fb->a_hi - fb->a_lo < 4 * s && fb->a_hi < fb->size - 1 )
+    fb->a_hi++;
+  while ( fb->a_hi - fb->a_lo < 4 * s && fb->a_lo > fb->small_end )
+    fb->a_lo--;
+  fb->s = s;
+
+  return 0;
+}
+
+static void* SIQS_Worker( void* arg ) {
+  struct siqs_job* job = (struct siqs_job*) arg;
+  long size = job->fb.size;
+
+  struct siqs_poly poly;
+  memset( &poly, 0, sizeof(poly) );
+  poly.job = job;
+  poly.rng = (uint64_t) (uintptr_t) &poly ^ 0x9E3779B97F4A7C15ull;
+  mpz_inits( poly.A, poly.b, poly.c, poly.tmp1, poly.tmp2, poly.Y, poly.g, NULL );
+  int l;
+  for ( l = 0; l < SIQS_MAX_A_PRIMES; l++ )
+    mpz_init( poly.B[l] );
+  poly.soln1 = (uint32_t*) calloc( size, sizeof(uint32_t) );
+  poly.soln2 = (uint32_t*) calloc( size, sizeof(uint32_t) );
+  poly.next1 = (uint32_t*) calloc( size, sizeof(uint32_t) );
+  poly.next2 = (uint32_t*) calloc( size, sizeof(uint32_t) );
+  poly.Bainv2 = (uint32_t*) calloc( size * SIQS_MAX_A_PRIMES, sizeof(uint32_t) );
+  poly.in_A = (char*) calloc( size, sizeof(char) );
+  poly.sieve = (uint8_t*) malloc( SIQS_BLOCK );
+
+  while ( !job->done ) {
+    if ( !New_A( &poly ) )
+      break;
+
+    // Walk the 2^(s-1) b values in Gray code order.  Going from i-1 to i
+    // flips the sign of B_v, v = lowest set bit of i.
+    long polys = 1L << (poly.s - 1);
+    long i;
+    for ( i = 0; i < polys && !job->done; i++ ) {
+      if ( i > 0 ) {
+        int v = __builtin_ctzl( i );
+        int negative = ((i ^ (i >> 1)) >> v) & 1;
+        uint32_t* Bainv2 = poly.Bainv2 + v * size;
+        long j;
+
+        mpz_mul_2exp( poly.tmp1, poly.B[v], 1 );
+        if ( negative )
+          mpz_sub( poly.b, poly.b, poly.tmp1 );
+        else
+          mpz_add( poly.b, poly.b, poly.tmp1 );
+
+        for ( j = 2; j < size; j++ ) {
+          if ( job->fb.special[j] || poly.in_A[j] )
+            continue;
+          uint32_t p = job->fb.prime[j];
+          if ( negative ) {
+            poly.soln1[j] += Bainv2[j];
+            if ( poly.soln1[j] >= p )
+              poly.soln1[j] -= p;
+            poly.soln2[j] += Bainv2[j];
+            if ( poly.soln2[j] >= p )
+              poly.soln2[j] -= p;
+          }
+          else {
+            poly.soln1[j] += p - Bainv2[j];
+            if ( poly.soln1[j] >= p )
+              poly.soln1[j] -= p;
+            poly.soln2[j] += p - Bainv2[j];
+            if ( poly.soln2[j] >= p )
+              poly.soln2[j] -= p;
+          }
+        }
+      }
+
+      // c = (b^2 - kN) / A
+      mpz_mul( poly.c, poly.b, poly.b );
+      mpz_sub( poly.c, poly.c, job->kn );
+      mpz_divexact( poly.c, poly.c, poly.A );
+
+      Sieve_Polynomial( &poly );
+    }
+  }
+
+  free( poly.sieve );
+  free( poly.in_A );
+  free( poly.Bainv2 );
+  free( poly.next2 );
+  free( poly.next1 );
+  free( poly.soln2 );
+  free( poly.soln1 );
+  for ( l = 0; l < SIQS_MAX_A_PRIMES; l++ )
+    mpz_clear( poly.B[l] );
+  mpz_clears( poly.A, poly.b, poly.c, poly.tmp1, poly.tmp2, poly.Y, poly.g, NULL );
+
+  return NULL;
+}
+
+// Pick a fresh A = q_1 ... q_s close to sqrt(2kN)/M, then set up B_l, b and
+// the roots of the first polynomial.  Returns 0 if no new A could be found.
+static int New_A( struct siqs_poly* poly ) {
+  struct siqs_job* job = poly->job;
+  struct siqs_fb* fb = &job->fb;
+  int s = fb->s;
+  long range = fb->a_hi - fb->a_lo;
+  int tries, l;
+  long j;
+
+  poly->s = s;
+  for ( tries = 0; tries < 1000; tries++ ) {
+    if ( poly->s > 0 )
+      for ( l = 0; l < s; l++ )
+        poly->in_A[poly->q_idx[l]] = 0;
+
+    // s-1 random primes from [a_lo, a_hi), then the last one to close the gap
+    mpz_set_ui( poly->A, 1 );
+    for ( l = 0; l < s - 1; l++ ) {
+      do {
+        j = fb->a_lo + (long) (next_random( &poly->rng ) % range);
+      } while ( poly->in_A[j] || fb->special[j] );
+      poly->q_idx[l] = j;
+      poly->in_A[j] = 1;
+      mpz_mul_ui( poly->A, poly->A, fb->prime[j] );
+    }
+
+    double log2_rest = job->log2_target_A - log2( mpz_get_d( poly->A ) );
+    double want = pow( 2.0, log2_rest );
+    long best = -1;
+    double best_diff = 0;
+    for ( j = fb->small_end; j < fb->size; j++ ) {
+      if ( poly->in_A[j] || fb->special[j] )
+        continue;
+      double diff = fabs( fb->prime[j] - want );
+      if ( best < 0 || diff < best_diff ) {
+        best = j;
+        best_diff = diff;
+      }
+      if ( fb->prime[j] > want )
+        break;
+    }
+    if ( best < 0 )
+      continue;
+    poly->q_idx[s-1] = best;
+    poly->in_A[best] = 1;
+    mpz_mul_ui( poly->A, poly->A, fb->prime[best] );
+
+    // reject an A that some thread has already used
+    uint64_t key = (uint64_t) mpz_getlimbn( poly->A, 0 );
+    int seen = 0;
+    pthread_mutex_lock( &job->lock );
+    for ( j = 0; j < job->used_A_count; j++ )
+      if ( job->used_A[j] == key ) {
+        seen = 1;
+        break;
+      }
+    if ( !seen ) {
+      if ( job->used_A_count == job->used_A_alloc ) {
+        job->used_A_alloc *= 2;
+        job->used_A = (uint64_t*) realloc( job->used_A, job->used_A_alloc * sizeof(uint64_t) );
+      }
+      job->used_A[job->used_A_count++] = key;
+    }
+    pthread_mutex_unlock( &job->lock );
+
+    if ( !seen )
+      break;
+  }
+  if ( tries == 1000 )
+    return 0;
+
+  // B_l = (A/q_l) . (t_l . (A/q_l)^-1 mod q_l), with t_l^2 == kN (mod q_l)
+  mpz_set_ui( poly->b, 0 );
+  for ( l = 0; l < s; l++ ) {
+    uint32_t q = fb->prime[poly->q_idx[l]];
+    mpz_divexact_ui( poly->tmp1, poly->A, q );
+    uint32_t a_l_modq = (uint32_t) mpz_fdiv_ui( poly->tmp1, q );
+    uint64_t gamma = (uint64_t) fb->sqrtkN[poly->q_idx[l]] * inv_modp( a_l_modq, q ) % q;
+    if ( gamma > q / 2 )
+      gamma = q - gamma;
+    mpz_mul_ui( poly->B[l], poly->tmp1, (unsigned long) gamma );
+    mpz_add( poly->b, poly->b, poly->B[l] );
+  }
+
+  // Roots of the first polynomial, shifted by M so they index [0, 2M)
+  for ( j = 2; j < fb->size; j++ ) {
+    if ( fb->special[j] || poly->in_A[j] )
+      continue;
+    uint32_t p = fb->prime[j];
+    uint32_t ainv = inv_modp( (uint32_t) mpz_fdiv_ui( poly->A, p ), p );
+    uint32_t b_modp = (uint32_t) mpz_fdiv_ui( poly->b, p );
+    uint32_t M_modp = (uint32_t) (job->M % p);
+    uint32_t t = fb->sqrtkN[j];
+
+    poly->soln1[j] = (uint32_t) (((uint64_t) ainv * ((t + p - b_modp) % p) + M_modp) % p);
+    poly->soln2[j] = (uint32_t) (((uint64_t) ainv * ((2 * p - t - b_modp) % p) + M_modp) % p);
+
+    for ( l = 0; l < s - 1; l++ ) {
+      uint32_t B_modp = (uint32_t) mpz_fdiv_ui( poly->B[l], p );
+      poly->Bainv2[l * fb->size + j] = (uint32_t) ((uint64_t) 2 * B_modp % p * ainv % p);
+    }
+  }
+
+  return 1;
+}
+
+// Sieve [0, 2M) one block at a time and check every candidate
+static void Sieve_Polynomial( struct siqs_poly* poly ) {
+  struct siqs_job* job = poly->job;
+  struct siqs_fb* fb = &job->fb;
+  long size = fb->size;
+  long j;
+
+  // Primes not sieved get a start past the end of the interval
+  for ( j = fb->small_end; j < size; j++ ) {
+    if ( fb->special[j] || poly->in_A[j] ) {
+      poly->next1[j] = UINT32_MAX;
+      poly->next2[j] = UINT32_MAX;
+      continue;
+    }
+    poly->next1[j] = poly->soln1[j];
+    poly->next2[j] = poly->soln2[j];
+  }
+
+  uint8_t* sieve = poly->sieve;
+  long block;
+  for ( block = 0; block < 2 * job->blocks; block++ ) {
+    uint32_t base = (uint32_t) (block * SIQS_BLOCK);
+    uint32_t end = base + SIQS_BLOCK;
+
+    memset( sieve, job->sieve_init, SIQS_BLOCK );
+
+    for ( j = fb->small_end; j < size; j++ ) {
+      uint32_t p = fb->prime[j];
+      uint8_t logp = fb->logp[j];
+      uint32_t r;
+
+      for ( r = poly->next1[j]; r < end; r += p )
+        sieve[r - base] += logp;
+      poly->next1[j] = r;
+
+      for ( r = poly->next2[j]; r < end; r += p )
+        sieve[r - base] += logp;
+      poly->next2[j] = r;
+    }
+
+    uint64_t* words = (uint64_t*) sieve;
+    long w;
+    for ( w = 0; w < SIQS_BLOCK / 8; w++ ) {
+      if ( !(words[w] & 0x8080808080808080ull) )
+        continue;
+      int byte;
+      for ( byte = 0; byte < 8; byte++ )
+        if ( sieve[w * 8 + byte] & 0x80 )
+          Check_Candidate( poly, (long) base + w * 8 + byte );
+    }
+
+    if ( job->done )
+      return;
+  }
+}
+
+// Trial divide g(x) over the factor base and save the relation if it is
+// full or has a single large prime.
+static void Check_Candidate( struct siqs_poly* poly, long i ) {
+  struct siqs_job* job = poly->job;
+  struct siqs_fb* fb = &job->fb;
+  long x = i - job->M;
+
+  uint32_t factors[SIQS_MAX_FACTORS];
+  int count = 0;
+
+  // Y = A.x + b,  g = A.x^2 + 2.b.x + c  so  Y^2 - kN = A.g
+  mpz_mul_si( poly->Y, poly->A, x );
+  mpz_add( poly->Y, poly->Y, poly->b );
+
+  mpz_mul_si( poly->g, poly->A, x );
+  mpz_addmul_ui( poly->g, poly->b, 2 );
+  mpz_mul_si( poly->g, poly->g, x );
+  mpz_add( poly->g, poly->g, poly->c );
+
+  if ( mpz_sgn( poly->g ) == 0 )
+    return;
+  if ( mpz_sgn( poly->g ) < 0 ) {
+    factors[count++] = 0;
+    mpz_neg( poly->g, poly->g );
+  }
+
+  int l;
+  for ( l = 0; l < poly->s; l++ )
+    factors[count++] = (uint32_t) poly->q_idx[l];
+
+  unsigned long twos = mpz_scan1( poly->g, 0 );
+  if ( twos > 0 ) {
+    mpz_fdiv_q_2exp( poly->g, poly->g, twos );
+    for ( ; twos > 0 && count < SIQS_MAX_FACTORS; twos-- )
+      factors[count++] = 1;
+  }
+
+  long j;
+  for ( j = 2; j < fb->size && count < SIQS_MAX_FACTORS; j++ ) {
+    uint32_t p = fb->prime[j];
+    if ( !fb->special[j] && !poly->in_A[j] ) {
+      uint32_t r = (uint32_t) (i % p);
+      if ( r != poly->soln1[j] && r != poly->soln2[j] )
+        continue;
+    }
+    else if ( !mpz_divisible_ui_p( poly->g, p ) )
+      continue;
+
+    while ( mpz_divisible_ui_p( poly->g, p ) && count < SIQS_MAX_FACTORS ) {
+      mpz_divexact_ui( poly->g, poly->g, p );
+      factors[count++] = (uint32_t) j;
+    }
+  }
+
+  if ( count >= SIQS_MAX_FACTORS )
+    return;
+
+  if ( mpz_cmp_ui( poly->g, 1 ) == 0 )
+    Save_Relation( job, poly->Y, factors, count, 1 );
+  else if ( mpz_cmp_ui( poly->g, job->lp_max ) < 0 )
+    Save_Relation( job, poly->Y, factors, count, mpz_get_ui( poly->g ) );
+}
+
+static void Save_Relation( struct siqs_job* job, mpz_t Y, uint32_t* factors, int count, unsigned long large_prime ) {
+  pthread_mutex_lock( &job->lock );
+
+  if ( job->done ) {
+    pthread_mutex_unlock( &job->lock );
+    return;
+  }
+
+  if ( job->relations_count == job->relations_alloc ) {
+    job->relations_alloc *= 2;
+    job->relations = (struct siqs_relation*) realloc( job->relations, job->relations_alloc * sizeof(struct siqs_relation) );
+  }
+
+  long index = job->relations_count++;
+  struct siqs_relation* rel = &job->relations[index];
+  mpz_init_set( rel->Y, Y );
+  rel->factors = (uint32_t*) malloc( count * sizeof(uint32_t) );
+  memcpy( rel->factors, factors, count * sizeof(uint32_t) );
+  rel->count = count;
+  rel->large_prime = large_prime;
+
+  if ( large_prime == 1 )
+    job->fulls++;
+  else if ( Lookup_Large_Prime( job, large_prime, index ) )
+    job->cycles++;
+
+  if ( job->fulls + job->cycles >= job->needed )
+    job->done = 1;
+
+  pthread_mutex_unlock( &job->lock );
+}
+
+// Open addressing table of large primes.  Returns 1 if the large prime was
+// already there (ie. a new cycle), otherwise records index as its first use.
+static int Lookup_Large_Prime( struct siqs_job* job, unsigned long large_prime, long index ) {
+  if ( 2 * job->lp_count >= job->lp_alloc ) {
+    long old_alloc = job->lp_alloc;
+    unsigned long* old_keys = job->lp_keys;
+    long* old_first = job->lp_first;
+
+    job->lp_alloc *= 2;
+    job->lp_keys = (unsigned long*) calloc( job->lp_alloc, sizeof(unsigned long) );
+    job->lp_first = (long*) calloc( job->lp_alloc, sizeof(long) );
+    long i;
+    for ( i = 0; i < old_alloc; i++ ) {
+      if ( old_keys[i] == 0 )
+        continue;
+      long h = (long) ((old_keys[i] * 0x9E3779B97F4A7C15ull) & (job->lp_alloc - 1));
+      while ( job->lp_keys[h] != 0 )
+        h = (h + 1) & (job->lp_alloc - 1);
+      job->lp_keys[h] = old_keys[i];
+      job->lp_first[h] = old_first[i];
+    }
+    free( old_keys );
+    free( old_first );
+  }
+
+  long h = (long) ((large_prime * 0x9E3779B97F4A7C15ull) & (job->lp_alloc - 1));
+  while ( job->lp_keys[h] != 0 ) {
+    if ( job->lp_keys[h] == large_prime )
+      return 1;
+    h = (h + 1) & (job->lp_alloc - 1);
+  }
+  job->lp_keys[h] = large_prime;
+  job->lp_first[h] = index;
+  job->lp_count++;
+  return 0;
+}
+
+// Build the GF(2) matrix, remove singletons, find dependencies by block
+// Lanczos and try each one until gcd(X - Y, N) is a proper factor.
+static int Find_Factor( struct siqs_job* job, mpz_t factor ) {
+  long size = job->fb.size;
+  long i, j;
+
+  // Columns are full relations, or two partials sharing a large prime.
+  long sets_count = 0;
+  long (*sets)[2] = (long (*)[2]) calloc( job->fulls + job->cycles + 1, sizeof(long[2]) );
+  for ( i = 0; i < job->relations_count; i++ ) {
+    struct siqs_relation* rel = &job->relations[i];
+    if ( rel->large_prime == 1 ) {
+      sets[sets_count][0] = i;
+      sets[sets_count][1] = -1;
+      sets_count++;
+      continue;
+    }
+    long h = (long) ((rel->large_prime * 0x9E3779B97F4A7C15ull) & (job->lp_alloc - 1));
+    while ( job->lp_keys[h] != rel->large_prime )
+      h = (h + 1) & (job->lp_alloc - 1);
+    long first = job->lp_first[h];
+    if ( first != i && sets_count < job->fulls + job->cycles ) {
+      sets[sets_count][0] = first;
+      sets[sets_count][1] = i;
+      sets_count++;
+    }
+  }
+
+  // Parity vectors, kept sparse for the singleton pass
+  char* parity = (char*) calloc( size, sizeof(char) );
+  uint32_t** odd = (uint32_t**) calloc( sets_count, sizeof(uint32_t*) );
+  int* odd_count = (int*) calloc( sets_count, sizeof(int) );
+  long* weight = (long*) calloc( size, sizeof(long) );
+  char* alive = (char*) calloc( sets_count, sizeof(char) );
+
+  for ( i = 0; i < sets_count; i++ ) {
+    int m;
+    for ( m = 0; m < 2 && sets[i][m] >= 0; m++ ) {
+      struct siqs_relation* rel = &job->relations[sets[i][m]];
+      for ( j = 0; j < rel->count; j++ )
+        parity[rel->factors[j]] ^= 1;
+    }
+    odd[i] = (uint32_t*) malloc( (SIQS_MAX_FACTORS * 2) * sizeof(uint32_t) );
+    for ( m = 0; m < 2 && sets[i][m] >= 0; m++ ) {
+      struct siqs_relation* rel = &job->relations[sets[i][m]];
+      for ( j = 0; j < rel->count; j++ )
+        if ( parity[rel->factors[j]] ) {
+          parity[rel->factors[j]] = 0;
+          odd[i][odd_count[i]++] = rel->factors[j];
+        }
+    }
+    odd[i] = (uint32_t*) realloc( odd[i], (odd_count[i] + 1) * sizeof(uint32_t) );
+    for ( j = 0; j < odd_count[i]; j++ )
+      weight[odd[i][j]]++;
+    alive[i] = 1;
+  }
+
+  // Singleton removal:  a prime appearing in only one column can never be
+  // squared away, so that column is useless.
+  int changed = 1;
+  while ( changed ) {
+    changed = 0;
+    for ( i = 0; i < sets_count; i++ ) {
+      if ( !alive[i] )
+        continue;
+      for ( j = 0; j < odd_count[i]; j++ )
+        if ( weight[odd[i][j]] == 1 )
+          break;
+      if ( j < odd_count[i] ) {
+        alive[i] = 0;
+        for ( j = 0; j < odd_count[i]; j++ )
+          weight[odd[i][j]]--;
+        changed = 1;
+      }
+    }
+  }
+
+  // Compact the surviving primes into rows, keep only as many columns as needed
+  long* row_of = (long*) calloc( size, sizeof(long) );
+  long rows = 0;
+  for ( j = 0; j < size; j++ )
+    row_of[j] = weight[j] > 0 ? rows++ : -1;
+
+  long cols = 0;
+  long* col_set = (long*) calloc( sets_count + 1, sizeof(long) );
+  for ( i = 0; i < sets_count && cols < rows + SIQS_EXCESS; i++ )
+    if ( alive[i] )
+      col_set[cols++] = i;
+
+  struct siqs_matrix matrix;
+  matrix.rows = rows;
+  matrix.cols = cols;
+  matrix.col_start = (long*) calloc( cols + 1, sizeof(long) );
+  for ( i = 0; i < cols; i++ )
+    matrix.col_start[i+1] = matrix.col_start[i] + odd_count[col_set[i]];
+  matrix.entries = (uint32_t*) malloc( (matrix.col_start[cols] + 1) * sizeof(uint32_t) );
+  for ( i = 0; i < cols; i++ )
+    for ( j = 0; j < odd_count[col_set[i]]; j++ )
+      matrix.entries[matrix.col_start[i] + j] = (uint32_t) row_of[odd[col_set[i]][j]];
+
+  // deps[i] has bit d set if column i is in dependency d
+  uint64_t* deps = NULL;
+  if ( cols < SIQS_LANCZOS_MIN )
+    deps = Dense_Dependencies( &matrix );
+  else {
+    uint64_t rng = 0x9E3779B97F4A7C15ull ^ (uint64_t) cols;
+    int tries;
+    for ( tries = 0; tries < SIQS_LANCZOS_TRIES && deps == NULL; tries++ )
+      deps = Block_Lanczos( &matrix, &rng );
+  }
+
+  int found = 0;
+  long* exps = (long*) calloc( size, sizeof(long) );
+  mpz_t X, Y, t;
+  mpz_inits( X, Y, t, NULL );
+
+  int d;
+  for ( d = 0; d < 64 && deps != NULL && !found; d++ ) {
+    memset( exps, 0, size * sizeof(long) );
+    mpz_set_ui( X, 1 );
+    mpz_set_ui( Y, 1 );
+
+    long used = 0;
+    for ( i = 0; i < cols; i++ ) {
+      if ( !((deps[i] >> d) & 1) )
+        continue;
+      used++;
+      long set = col_set[i];
+      int m;
+      for ( m = 0; m < 2 && sets[set][m] >= 0; m++ ) {
+        struct siqs_relation* rel = &job->relations[sets[set][m]];
+        mpz_mul( X, X, rel->Y );
+        mpz_mod( X, X, job->n );
+        for ( j = 0; j < rel->count; j++ )
+          exps[rel->factors[j]]++;
+      }
+      if ( sets[set][1] >= 0 ) {
+        mpz_mul_ui( Y, Y, job->relations[sets[set][0]].large_prime );
+        mpz_mod( Y, Y, job->n );
+      }
+    }
+
+    // an empty or broken dependency is skipped
+    for ( j = 0; j < size && !(exps[j] & 1); j++ )
+      ;
+    if ( used == 0 || j < size )
+      continue;
+
+    for ( j = 1; j < size; j++ ) {
+      if ( exps[j] == 0 )
+        continue;
+      mpz_set_ui( t, job->fb.prime[j] );
+      mpz_powm_ui( t, t, exps[j] / 2, job->n );
+      mpz_mul( Y, Y, t );
+      mpz_mod( Y, Y, job->n );
+    }
+
+    mpz_sub( t, X, Y );
+    mpz_gcd( factor, t, job->n );
+    if ( mpz_cmp_ui( factor, 1 ) > 0 && mpz_cmp( factor, job->n ) < 0 )
+      found = 1;
+  }
+
+  mpz_clears( X, Y, t, NULL );
+  free( exps );
+  free( deps );
+  free( matrix.entries );
+  free( matrix.col_start );
+  free( col_set );
+  free( row_of );
+  for ( i = 0; i < sets_count; i++ )
+    free( odd[i] );
+  free( alive );
+  free( weight );
+  free( odd_count );
+  free( odd );
+  free( parity );
+  free( sets );
+
+  return found;
+}
+
+// Gaussian elimination on the columns as bit rows [ parity over rows | identity ].
+// Returns up to 64 dependencies, deps[i] bit d set if column i is in the d-th,
+// or NULL if there are none.
+static uint64_t* Dense_Dependencies( struct siqs_matrix* matrix ) {
+  long rows = matrix->rows, cols = matrix->cols;
+  long i, j, r, k;
+
+  long w1 = (rows + 63) / 64;
+  long w2 = (cols + 63) / 64;
+  long width = w1 + w2;
+  uint64_t* bits = (uint64_t*) calloc( cols * width, sizeof(uint64_t) );
+  for ( i = 0; i < cols; i++ ) {
+    uint64_t* row = bits + i * width;
+    for ( k = matrix->col_start[i]; k < matrix->col_start[i+1]; k++ )
+      row[matrix->entries[k] >> 6] |= 1ull << (matrix->entries[k] & 63);
+    row[w1 + (i >> 6)] |= 1ull << (i & 63);
+  }
+
+  long rank = 0;
+  for ( j = 0; j < rows && rank < cols; j++ ) {
+    uint64_t bit = 1ull << (j & 63);
+    long word = j >> 6;
+    for ( r = rank; r < cols; r++ )
+      if ( bits[r * width + word] & bit )
+        break;
+    if ( r == cols )
+      continue;
+
+    if ( r != rank ) {
+      for ( k = 0; k < width; k++ ) {
+        uint64_t t = bits[r * width + k];
+        bits[r * width + k] = bits[rank * width + k];
+        bits[rank * width + k] = t;
+      }
+    }
+
+    uint64_t* pivot = bits + rank * width;
+    for ( r = rank + 1; r < cols; r++ ) {
+      uint64_t* row = bits + r * width;
+      if ( row[word] & bit )
+        for ( k = word; k < width; k++ )
+          row[k] ^= pivot[k];
+    }
+    rank++;
+  }
+
+  // Rows from rank onwards are dependencies
+  uint64_t* deps = NULL;
+  if ( rank < cols ) {
+    deps = (uint64_t*) calloc( cols, sizeof(uint64_t) );
+    for ( r = rank; r < cols && r - rank < 64; r++ )
+      for ( i = 0; i < cols; i++ )
+        if ( bits[r * width + w1 + (i >> 6)] & (1ull << (i & 63)) )
+          deps[i] |= 1ull << (r - rank);
+  }
+
+  free( bits );
+  return deps;
+}
+
+// Block Lanczos over GF(2), after Montgomery, "A Block Lanczos Algorithm for
+// Finding Dependencies over GF(2)" (Eurocrypt '95).  It solves A.x == A.y for
+// the symmetric A = B'.B with 64 vectors at a time, using B only through
+// sparse products, so it takes about cols/63 iterations of O(weight of B)
+// and memory for a handful of cols x 64 bit blocks.  Returns dependencies
+// as Dense_Dependencies does, or NULL if the iteration broke down (another
+// random start usually works).
+static uint64_t* Block_Lanczos( struct siqs_matrix* matrix, uint64_t* rng ) {
+  long n = matrix->cols;
+  long i;
+
+  uint64_t* v[3];
+  for ( i = 0; i < 3; i++ )
+    v[i] = (uint64_t*) calloc( n, sizeof(uint64_t) );
+  uint64_t* vnext = (uint64_t*) calloc( n, sizeof(uint64_t) );
+  uint64_t* v0 = (uint64_t*) calloc( n, sizeof(uint64_t) );
+  uint64_t* x = (uint64_t*) calloc( n, sizeof(uint64_t) );
+  uint64_t* scratch = (uint64_t*) calloc( matrix->rows + 1, sizeof(uint64_t) );
+
+  // Index 0 is this iteration, 1 and 2 the ones before
+  uint64_t vt_a_v[2][64], vt_a2_v[2][64], winv[3][64];
+  uint64_t vt_v0[64], d[64], e[64], f[64], f2[64];
+  int s[2][64];
+  int dim0, dim1 = 64;
+  memset( vt_a_v, 0, sizeof(vt_a_v) );
+  memset( vt_a2_v, 0, sizeof(vt_a2_v) );
+  memset( winv, 0, sizeof(winv) );
+  for ( i = 0; i < 64; i++ )
+    s[1][i] = (int) i;
+
+  // x starts out random and v0 = A.x, so when the iteration adds the
+  // solution of A.z == v0 to it, A.x == 0
+  for ( i = 0; i < n; i++ )
+    x[i] = next_random( rng );
+  Mul_Sym( matrix, x, v[0], scratch );
+  memcpy( v0, v[0], n * sizeof(uint64_t) );
+
+  int finished = 0;
+  long iteration, max_iterations = n / 60 + 64;
+  for ( iteration = 0; iteration < max_iterations; iteration++ ) {
+    Mul_Sym( matrix, v[0], vnext, scratch );
+    Mul_64xN_Nx64( v[0], vnext, vt_a_v[0], n );
+    Mul_64xN_Nx64( vnext, vnext, vt_a2_v[0], n );
+
+    // V'.A.V == 0 is the end
+    for ( i = 0; i < 64 && vt_a_v[0][i] == 0; i++ )
+      ;
+    if ( i == 64 ) {
+      finished = 1;
+      break;
+    }
+
+    dim0 = Find_Nonsingular_Sub( vt_a_v[0], s[0], s[1], dim1, winv[0] );
+    if ( dim0 == 0 )
+      break;
+
+    // the recurrence needs every column used in this or the last iteration
+    uint64_t mask0 = 0, mask1 = 0;
+    for ( i = 0; i < dim0; i++ )
+      mask0 |= 1ull << s[0][i];
+    for ( i = 0; i < dim1; i++ )
+      mask1 |= 1ull << s[1][i];
+    if ( (mask0 | mask1) != ~0ull )
+      break;
+
+    for ( i = 0; i < n; i++ )
+      vnext[i] &= mask0;
+
+    Mul_64xN_Nx64( v[0], v0, vt_v0, n );
+
+    // D = I - Winv0.(V0'.A^2.V0.S0.S0' + V0'.A.V0)
+    for ( i = 0; i < 64; i++ )
+      d[i] = (vt_a2_v[0][i] & mask0) ^ vt_a_v[0][i];
+    Mul_64x64_64x64( winv[0], d, d );
+    for ( i = 0; i < 64; i++ )
+      d[i] ^= 1ull << i;
+
+    // E = Winv1.V0'.A.V0.S0.S0'
+    Mul_64x64_64x64( winv[1], vt_a_v[0], e );
+    for ( i = 0; i < 64; i++ )
+      e[i] &= mask0;
+
+    // F = Winv2.(I - V1'.A.V1.Winv1).(V1'.A^2.V1.S1.S1' + V1'.A.V1).S0.S0'
+    Mul_64x64_64x64( vt_a_v[1], winv[1], f );
+    for ( i = 0; i < 64; i++ )
+      f[i] ^= 1ull << i;
+    Mul_64x64_64x64( winv[2], f, f );
+    for ( i = 0; i < 64; i++ )
+      f2[i] = ((vt_a2_v[1][i] & mask1) ^ vt_a_v[1][i]) & mask0;
+    Mul_64x64_64x64( f, f2, f );
+
+    // V_next = A.V0.S0.S0' + V0.D + V1.E + V2.F
+    Mul_Nx64_64x64_Acc( v[0], d, vnext, n );
+    Mul_Nx64_64x64_Acc( v[1], e, vnext, n );
+    Mul_Nx64_64x64_Acc( v[2], f, vnext, n );
+
+    // x += V0.Winv0.V0'.v0
+    Mul_64x64_64x64( winv[0], vt_v0, d );
+    Mul_Nx64_64x64_Acc( v[0], d, x, n );
+
+    uint64_t* oldest = v[2];
+    v[2] = v[1];
+    v[1] = v[0];
+    v[0] = vnext;
+    vnext = oldest;
+    memcpy( winv[2], winv[1], sizeof(winv[1]) );
+    memcpy( winv[1], winv[0], sizeof(winv[0]) );
+    memcpy( vt_a_v[1], vt_a_v[0], sizeof(vt_a_v[0]) );
+    memcpy( vt_a2_v[1], vt_a2_v[0], sizeof(vt_a2_v[0]) );
+    memcpy( s[1], s[0], sizeof(s[0]) );
+    dim1 = dim0;
+  }
+
+  uint64_t* deps = NULL;
+  if ( finished )
+    deps = Combine_Cofactors( matrix, x, v[0] );
+
+  for ( i = 0; i < 3; i++ )
+    free( v[i] );
+  free( vnext );
+  free( v0 );
+  free( x );
+  free( scratch );
+
+  return deps;
+}
+
+// At the end of the iteration A.x == 0 and A.v is (nearly) 0, but B.x and
+// B.v need not be.  Find the combinations of the 128 columns of x and v
+// that B sends to 0 by elimination on their images.
+static uint64_t* Combine_Cofactors( struct siqs_matrix* matrix, uint64_t* x, uint64_t* v ) {
+  long rows = matrix->rows, n = matrix->cols;
+  long words = (rows + 63) / 64 + 1;
+  long r, k, w;
+
+  uint64_t* bx = (uint64_t*) calloc( rows + 1, sizeof(uint64_t) );
+  uint64_t* bv = (uint64_t*) calloc( rows + 1, sizeof(uint64_t) );
+  Mul_B( matrix, x, bx );
+  Mul_B( matrix, v, bv );
+
+  // image row k is B times column k of [ x | v ], combo[k] says which
+  // columns of [ x | v ] it is the sum of
+  uint64_t* image = (uint64_t*) calloc( 128 * words, sizeof(uint64_t) );
+  uint64_t combo[128][2];
+  for ( r = 0; r < rows; r++ )
+    for ( k = 0; k < 64; k++ ) {
+      if ( (bx[r] >> k) & 1 )
+        image[k * words + (r >> 6)] |= 1ull << (r & 63);
+      if ( (bv[r] >> k) & 1 )
+        image[(k + 64) * words + (r >> 6)] |= 1ull << (r & 63);
+    }
+  for ( k = 0; k < 128; k++ ) {
+    combo[k][0] = k < 64 ? 1ull << k : 0;
+    combo[k][1] = k < 64 ? 0 : 1ull << (k - 64);
+  }
+
+  long rank = 0;
+  for ( r = 0; r < rows && rank < 128; r++ ) {
+    long word = r >> 6;
+    uint64_t bit = 1ull << (r & 63);
+    for ( k = rank; k < 128 && !(image[k * words + word] & bit); k++ )
+      ;
+    if ( k == 128 )
+      continue;
+
+    if ( k != rank ) {
+      for ( w = 0; w < words; w++ ) {
+        uint64_t t = image[k * words + w];
+        image[k * words + w] = image[rank * words + w];
+        image[rank * words + w] = t;
+      }
+      uint64_t t0 = combo[k][0], t1 = combo[k][1];
+      combo[k][0] = combo[rank][0];
+      combo[k][1] = combo[rank][1];
+      combo[rank][0] = t0;
+      combo[rank][1] = t1;
+    }
+
+    for ( k = rank + 1; k < 128; k++ )
+      if ( image[k * words + word] & bit ) {
+        for ( w = word; w < words; w++ )
+          image[k * words + w] ^= image[rank * words + w];
+        combo[k][0] ^= combo[rank][0];
+        combo[k][1] ^= combo[rank][1];
+      }
+    rank++;
+  }
+
+  // Rows from rank onwards have a zero image.  Keep the non-zero ones.
+  uint64_t* deps = (uint64_t*) calloc( n, sizeof(uint64_t) );
+  int count = 0;
+  for ( k = rank; k < 128 && count < 64; k++ ) {
+    uint64_t bit = 1ull << count;
+    int any = 0;
+    long i;
+    for ( i = 0; i < n; i++ )
+      if ( (__builtin_popcountll( x[i] & combo[k][0] ) ^ __builtin_popcountll( v[i] & combo[k][1] )) & 1 ) {
+        deps[i] |= bit;
+        any = 1;
+      }
+    count += any;
+  }
+
+  free( image );
+  free( bv );
+  free( bx );
+
+  if ( count == 0 ) {
+    free( deps );
+    return NULL;
+  }
+  return deps;
+}
+
+// Montgomery's choice of the columns S of V that make S'.V'.A.V.S invertible,
+// preferring the ones left out last time.  Sets w to that inverse (zero
+// outside S) and s[0 .. dim-1] to S, and returns dim (0 if t is singular in
+// a way that can't be worked around).
+static int Find_Nonsingular_Sub( uint64_t* t, int* s, int* last_s, int last_dim, uint64_t* w ) {
+  uint64_t M[64][2];
+  int i, j, dim;
+
+  // M = [ t | I ]
+  for ( i = 0; i < 64; i++ ) {
+    M[i][0] = t[i];
+    M[i][1] = 1ull << i;
+  }
+
+  // the columns not in last_s go first
+  uint64_t mask = 0;
+  for ( i = 0; i < last_dim; i++ ) {
+    mask |= 1ull << last_s[i];
+    s[63 - i] = last_s[i];
+  }
+  for ( i = j = 0; i < 64; i++ )
+    if ( !(mask & (1ull << i)) )
+      s[j++] = i;
+
+  for ( i = dim = 0; i < 64; i++ ) {
+    uint64_t bit = 1ull << s[i];
+    uint64_t* row_i = M[s[i]];
+
+    for ( j = i; j < 64; j++ ) {
+      uint64_t* row_j = M[s[j]];
+      if ( row_j[0] & bit ) {
+        uint64_t m0 = row_j[0], m1 = row_j[1];
+        row_j[0] = row_i[0];
+        row_j[1] = row_i[1];
+        row_i[0] = m0;
+        row_i[1] = m1;
+        break;
+      }
+    }
+
+    // a pivot:  clear its column from the other rows and accept it
+    if ( j < 64 ) {
+      for ( j = 0; j < 64; j++ ) {
+        uint64_t* row_j = M[s[j]];
+        if ( row_j != row_i && (row_j[0] & bit) ) {
+          row_j[0] ^= row_i[0];
+          row_j[1] ^= row_i[1];
+        }
+      }
+      s[dim++] = s[i];
+      continue;
+    }
+
+    // no pivot:  clear the column from the right hand side instead, and drop it
+    for ( j = i; j < 64; j++ ) {
+      uint64_t* row_j = M[s[j]];
+      if ( row_j[1] & bit ) {
+        uint64_t m0 = row_j[0], m1 = row_j[1];
+        row_j[0] = row_i[0];
+        row_j[1] = row_i[1];
+        row_i[0] = m0;
+        row_i[1] = m1;
+        break;
+      }
+    }
+    if ( j == 64 )
+      return 0;
+
+    for ( j = 0; j < 64; j++ ) {
+      uint64_t* row_j = M[s[j]];
+      if ( row_j != row_i && (row_j[1] & bit) ) {
+        row_j[0] ^= row_i[0];
+        row_j[1] ^= row_i[1];
+      }
+    }
+    row_i[0] = row_i[1] = 0;
+  }
+
+  for ( i = 0; i < 64; i++ )
+    w[i] = M[i][1];
+
+  return dim;
+}
+
+// out (rows) = B.v
+static void Mul_B( struct siqs_matrix* matrix, uint64_t* v, uint64_t* out ) {
+  long i, k;
+  memset( out, 0, matrix->rows * sizeof(uint64_t) );
+  for ( i = 0; i < matrix->cols; i++ ) {
+    uint64_t vi = v[i];
+    for ( k = matrix->col_start[i]; k < matrix->col_start[i+1]; k++ )
+      out[matrix->entries[k]] ^= vi;
+  }
+}
+
+// out (cols) = B'.B.v, with scratch holding rows words
+static void Mul_Sym( struct siqs_matrix* matrix, uint64_t* v, uint64_t* out, uint64_t* scratch ) {
+  long i, k;
+  Mul_B( matrix, v, scratch );
+  for ( i = 0; i < matrix->cols; i++ ) {
+    uint64_t sum = 0;
+    for ( k = matrix->col_start[i]; k < matrix->col_start[i+1]; k++ )
+      sum ^= scratch[matrix->entries[k]];
+    out[i] = sum;
+  }
+}
+
+// out (64 x 64) = x'.y, a byte of x at a time
+static void Mul_64xN_Nx64( uint64_t* x, uint64_t* y, uint64_t* out, long n ) {
+  uint64_t tables[8][256];
+  long i;
+  int b, bit, value;
+
+  memset( tables, 0, sizeof(tables) );
+  for ( i = 0; i < n; i++ ) {
+    uint64_t xi = x[i], yi = y[i];
+    for ( b = 0; b < 8; b++ )
+      tables[b][(xi >> (8 * b)) & 0xFF] ^= yi;
+  }
+
+  for ( b = 0; b < 8; b++ )
+    for ( bit = 0; bit < 8; bit++ ) {
+      uint64_t sum = 0;
+      for ( value = 1; value < 256; value++ )
+        if ( (value >> bit) & 1 )
+          sum ^= tables[b][value];
+      out[8 * b + bit] = sum;
+    }
+}
+
+// y (n x 64) ^= v.m for the 64 x 64 m, a byte of v at a time
+static void Mul_Nx64_64x64_Acc( uint64_t* v, uint64_t* m, uint64_t* y, long n ) {
+  uint64_t tables[8][256];
+  long i;
+  int b, value;
+
+  for ( b = 0; b < 8; b++ ) {
+    tables[b][0] = 0;
+    for ( value = 1; value < 256; value++ )
+      tables[b][value] = tables[b][value & (value - 1)] ^ m[8 * b + __builtin_ctz( value )];
+  }
+
+  for ( i = 0; i < n; i++ ) {
+    uint64_t vi = v[i], sum = 0;
+    for ( b = 0; b < 8; b++ )
+      sum ^= tables[b][(vi >> (8 * b)) & 0xFF];
+    y[i] ^= sum;
+  }
+}
+
+// c = a.b, all 64 x 64.  c may be a or b.
+static void Mul_64x64_64x64( uint64_t* a, uint64_t* b, uint64_t* c ) {
+  uint64_t product[64];
+  int i;
+  for ( i = 0; i < 64; i++ ) {
+    uint64_t ai = a[i], sum = 0;
+    while ( ai != 0 ) {
+      sum ^= b[__builtin_ctzll( ai )];
+      ai &= ai - 1;
+    }
+    product[i] = sum;
+  }
+  memcpy( c, product, sizeof(product) );
+}
+
+// Tonelli-Shanks.  a must be a non-zero quadratic residue mod the odd prime p.
+static uint32_t sqrt_modp( uint32_t a, uint32_t p ) {
+  if ( p % 4 == 3 )
+    return pow_modp( a, (p + 1) / 4, p );
+
+  uint32_t q = p - 1;
+  int s = 0;
+  while ( !(q & 1) ) {
+    q >>= 1;
+    s++;
+  }
+
+  uint32_t z = 2;
+  while ( pow_modp( z, (p - 1) / 2, p ) != p - 1 )
+    z++;
+
+  uint32_t c = pow_modp( z, q, p );
+  uint32_t r = pow_modp( a, (q + 1) / 2, p );
+  uint32_t t = pow_modp( a, q, p );
+  int m = s;
+
+  while ( t != 1 ) {
+    int i = 0;
+    uint32_t tt = t;
+    while ( tt != 1 ) {
+      tt = (uint32_t) ((uint64_t) tt * tt % p);
+      i++;
+    }
+    uint32_t b = c;
+    int e;
+    for ( e = 0; e < m - i - 1; e++ )
+      b = (uint32_t) ((uint64_t) b * b % p);
+    r = (uint32_t) ((uint64_t) r * b % p);
+    c = (uint32_t) ((uint64_t) b * b % p);
+    t = (uint32_t) ((uint64_t) t * c % p);
+    m = i;
+  }
+
+  return r;
+}
+
+// a^-1 mod p by the extended Euclidean algorithm
+static uint32_t inv_modp( uint32_t a, uint32_t p ) {
+  int64_t t = 0, new_t = 1;
+  int64_t r = p, new_r = a % p;
+  while ( new_r != 0 ) {
+    int64_t quot = r / new_r;
+    int64_t tmp = t - quot * new_t;
+    t = new_t;
+    new_t = tmp;
+    tmp = r - quot * new_r;
+    r = new_r;
+    new_r = tmp;
+  }
+  if ( t < 0 )
+    t += p;
+  return (uint32_t) t;
+}
+
+static uint32_t pow_modp( uint32_t base, uint32_t e, uint32_t p ) {
+  uint64_t result = 1;
+  uint64_t b = base % p;
+  while ( e > 0 ) {
+    if ( e & 1 )
+      result = result * b % p;
+    b = b * b % p;
+    e >>= 1;
+  }
+  return (uint32_t) result;
+}
+
+// xorshift64*
+static uint64_t next_random( uint64_t* state ) {
+  uint64_t x = *state;
+  x ^= x >> 12;
+  x ^= x << 25;
+  x ^= x >> 27;
+  *state = x;
+  return x * 0x2545F4914F6CDD1Dull;
+}
@@ -0,0 +1,13 @@
+/* Public Domain.  See the LICENSE file.                                     */
+
+/* Self-Initializing Quadratic Sieve, see siqs.c                             */
+
+#ifndef SIQS_H
+#define SIQS_H
+
+#include <gmp.h>
+#include "factor_infos.h"
+
+char SIQS( mpz_t, int, struct factor_infos* );
+
+#endif
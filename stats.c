@@ -0,0 +1,188 @@
+/* Public Domain.  See the LICENSE file.                                     */
+
+/* Instrumentation for the --stats option of the programs.  A run is split   */
+/* into phases; each phase gets its wall time and, where the kernel allows   */
+/* it, hardware counters (cycles, last level cache misses, branch misses)    */
+/* read through perf_event_open.  The programs keep their own counts (eg.    */
+/* crossing-off writes) in local variables and hand them over once, at the   */
+/* end of a phase, with Stats_Count(), so with --stats off nothing is done   */
+/* in the hot loops.                                                         */
+/*                                                                           */
+/* "--stats" prints a table and "--stats=json" prints JSON, both to stderr   */
+/* so they never mix with the program's own output.                          */
+
+/* No dependencies.  Linked into the programs, eg.                           */
+/*   cc eratosthenes.c stats.c -o eratosthenes                               */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "stats.h"
+
+static const char* hw_names[STATS_HW_COUNT] = { "cycles", "LLC misses", "branch misses" };
+static const char* hw_keys[STATS_HW_COUNT]  = { "cycles", "llc_misses", "branch_misses" };
+
+static int Open_HW_Counter( uint32_t, uint64_t );
+static void Read_HW_Counters( struct stats*, uint64_t* );
+
+// Look for --stats or --stats=json in argv and remove it, so the program's
+// own argument checks are unchanged.
+void Stats_Init( struct stats* stats, int* argc, char** argv ) {
+  memset( stats, 0, sizeof(struct stats) );
+
+  int i, j;
+  for ( i = 0; i < STATS_HW_COUNT; i++ )
+    stats->hw_fd[i] = -1;
+
+  for ( i = 1, j = 1; i < *argc; i++ ) {
+    if ( !strcmp( argv[i], "--stats" ) )
+      stats->enabled = 1;
+    else if ( !strcmp( argv[i], "--stats=json" ) )
+      stats->enabled = stats->json = 1;
+    else
+      argv[j++] = argv[i];
+  }
+  argv[j] = NULL;
+  *argc = j;
+
+  if ( !stats->enabled )
+    return;
+
+  // not all machines (or containers) allow these.  -1 means not available
+  stats->hw_fd[STATS_CYCLES]        = Open_HW_Counter( PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES );
+  stats->hw_fd[STATS_LLC_MISSES]    = Open_HW_Counter( PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES );
+  stats->hw_fd[STATS_BRANCH_MISSES] = Open_HW_Counter( PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES );
+}
+
+void Stats_Phase_Start( struct stats* stats, const char* name ) {
+  if ( !stats->enabled || stats->phase_count == STATS_MAX_PHASES )
+    return;
+
+  struct stats_phase* phase = &stats->phases[stats->phase_count++];
+  memset( phase, 0, sizeof(struct stats_phase) );
+  phase->name = name;
+
+  Read_HW_Counters( stats, stats->hw_started );
+  clock_gettime( CLOCK_MONOTONIC, &stats->started );
+}
+
+void Stats_Phase_Stop( struct stats* stats ) {
+  if ( !stats->enabled || stats->phase_count == 0 )
+    return;
+
+  struct timespec now;
+  clock_gettime( CLOCK_MONOTONIC, &now );
+  uint64_t hw[STATS_HW_COUNT];
+  Read_HW_Counters( stats, hw );
+
+  struct stats_phase* phase = &stats->phases[stats->phase_count - 1];
+  phase->seconds = (now.tv_sec - stats->started.tv_sec) + (now.tv_nsec - stats->started.tv_nsec) / 1e9;
+  int h;
+  for ( h = 0; h < STATS_HW_COUNT; h++ )
+    phase->hw[h] = hw[h] - stats->hw_started[h];
+}
+
+// Record a count against the phase started last
+void Stats_Count( struct stats* stats, const char* name, uint64_t value ) {
+  if ( !stats->enabled || stats->counter_count == STATS_MAX_COUNTERS )
+    return;
+
+  struct stats_counter* counter = &stats->counters[stats->counter_count++];
+  counter->phase = stats->phase_count - 1;
+  counter->name  = name;
+  counter->value = value;
+}
+
+void Stats_Print( struct stats* stats, FILE* out ) {
+  if ( !stats->enabled )
+    return;
+
+  int p, c, h;
+
+  if ( stats->json ) {
+    fprintf( out, "{ \"phases\": [" );
+    for ( p = 0; p < stats->phase_count; p++ ) {
+      struct stats_phase* phase = &stats->phases[p];
+      fprintf( out, "%s\n  { \"name\": \"%s\", \"secs\": %.9f", p ? "," : "", phase->name, phase->seconds );
+      for ( h = 0; h < STATS_HW_COUNT; h++ )
+        if ( stats->hw_fd[h] >= 0 )
+          fprintf( out, ", \"%s\": %ju", hw_keys[h], (uintmax_t) phase->hw[h] );
+      fprintf( out, ", \"counters\": {" );
+      int first = 1;
+      for ( c = 0; c < stats->counter_count; c++ ) {
+        if ( stats->counters[c].phase != p )
+          continue;
+        fprintf( out, "%s \"%s\": %ju", first ? "" : ",", stats->counters[c].name, (uintmax_t) stats->counters[c].value );
+        first = 0;
+      }
+      fprintf( out, " } }" );
+    }
+    fprintf( out, "\n] }\n" );
+    return;
+  }
+
+  fprintf( out, "\n%-28s %15s", "phase", "secs" );
+  for ( h = 0; h < STATS_HW_COUNT; h++ )
+    fprintf( out, " %16s", hw_names[h] );
+  fprintf( out, "\n" );
+
+  for ( p = 0; p < stats->phase_count; p++ ) {
+    struct stats_phase* phase = &stats->phases[p];
+    fprintf( out, "%-28s %15.9f", phase->name, phase->seconds );
+    for ( h = 0; h < STATS_HW_COUNT; h++ ) {
+      if ( stats->hw_fd[h] >= 0 )
+        fprintf( out, " %16ju", (uintmax_t) phase->hw[h] );
+      else
+        fprintf( out, " %16s", "n/a" );
+    }
+    fprintf( out, "\n" );
+
+    for ( c = 0; c < stats->counter_count; c++ )
+      if ( stats->counters[c].phase == p )
+        fprintf( out, "  %-26s %15ju\n", stats->counters[c].name, (uintmax_t) stats->counters[c].value );
+  }
+  fprintf( out, "\n" );
+}
+
+void Stats_Cleanup( struct stats* stats ) {
+  if ( !stats->enabled )
+    return;
+
+  int h;
+  for ( h = 0; h < STATS_HW_COUNT; h++ ) {
+    if ( stats->hw_fd[h] >= 0 )
+      close( stats->hw_fd[h] );
+    stats->hw_fd[h] = -1;
+  }
+  stats->enabled = 0;
+}
+
+// User space only counter for this process and the threads it starts
+static int Open_HW_Counter( uint32_t type, uint64_t config ) {
+  struct perf_event_attr attr;
+  memset( &attr, 0, sizeof(attr) );
+  attr.size           = sizeof(attr);
+  attr.type           = type;
+  attr.config         = config;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv     = 1;
+  attr.inherit        = 1;
+
+  return (int) syscall( SYS_perf_event_open, &attr, 0, -1, -1, 0 );
+}
+
+static void Read_HW_Counters( struct stats* stats, uint64_t* values ) {
+  int h;
+  for ( h = 0; h < STATS_HW_COUNT; h++ ) {
+    values[h] = 0;
+    if ( stats->hw_fd[h] >= 0 && read( stats->hw_fd[h], &values[h], sizeof(uint64_t) ) != sizeof(uint64_t) )
+      values[h] = 0;
+  }
+}
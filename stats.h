@@ -0,0 +1,49 @@
+/* Public Domain.  See the LICENSE file.                                     */
+
+/* The --stats instrumentation shared by the programs, see stats.c           */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+#define STATS_MAX_PHASES    8
+#define STATS_MAX_COUNTERS  24
+
+enum stats_hw { STATS_CYCLES, STATS_LLC_MISSES, STATS_BRANCH_MISSES, STATS_HW_COUNT };
+
+struct stats_phase {
+const char*     name;
+double          seconds;
+uint64_t        hw[STATS_HW_COUNT];
+};
+
+struct stats_counter {
+int             phase;
+const char*     name;
+uint64_t        value;
+};
+
+// All zero (ie. enabled == 0) until Stats_Init() sees --stats
+struct stats {
+int                   enabled;
+int                   json;
+int                   hw_fd[STATS_HW_COUNT];
+int                   phase_count;
+int                   counter_count;
+struct stats_phase    phases[STATS_MAX_PHASES];
+struct stats_counter  counters[STATS_MAX_COUNTERS];
+struct timespec       started;
+uint64_t              hw_started[STATS_HW_COUNT];
+};
+
+void Stats_Init( struct stats*, int*, char** );
+void Stats_Phase_Start( struct stats*, const char* );
+void Stats_Phase_Stop( struct stats* );
+void Stats_Count( struct stats*, const char*, uint64_t );
+void Stats_Print( struct stats*, FILE* );
+void Stats_Cleanup( struct stats* );
+
+#endif
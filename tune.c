@@ -0,0 +1,339 @@
+/* Public Domain.  See the LICENSE file.                                     */
+
+/* Tunes the programs for this machine and writes the machine profile that   */
+/* they read at startup (see profile.c).  Each setting below is tried at     */
+/* each of its candidate values on a small workload of its own:  the         */
+/* programs are run as child processes, as bench.c does, with                */
+/* FACTORING_PROFILE pointing at a scratch profile holding the candidate.    */
+/* The fastest (minimum over the runs) wins, but the default is kept unless  */
+/* another value beats it by more than TUNE_MIN_GAIN, so noise does not move */
+/* settings about.  Settings are tuned in order and each one is tried with   */
+/* the ones already chosen, so eg. the thread count is picked for the best   */
+/* segment size.                                                             */
+/*                                                                           */
+/*   factor_range.segment_size   numbers per segment, sized for the caches   */
+/*   factor_range.threads        threads used when -t is not given           */
+/*   coord.segment_size          bytes per segment in coord's count units    */
+/*   factor.tf_limit             trial division bound before rho             */
+/*   factor.rho_iterations       length of the rho run before ECM / SIQS     */
+/*   factor.siqs_min_bits        smallest composite given to SIQS            */
+
+/* No dependencies.  Normally built with make and run from the directory     */
+/* holding the programs, see Makefile.                                       */
+/* On linux, try:  cc -O2 tune.c profile.c -o tune                           */
+/*                 ./tune                                                    */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "profile.h"
+
+#define TUNE_MAX_ARGS        8
+#define TUNE_MAX_COMMANDS    6
+#define TUNE_MAX_CANDIDATES  12
+#define TUNE_MIN_GAIN        0.03     // 3%
+#define TUNE_JOB_DIR         "tune_job"
+
+struct command {
+const char*     args[TUNE_MAX_ARGS];    // program first, NULL terminated
+int             coord_job;              // run "coord init" first, untimed
+};
+
+// coord.segment_size is timed on "coord worker" alone.  "coord run" only
+// looks at done/ every 0.1s, which rounds each run up by more than the
+// segment size changes it.
+
+struct tunable {
+const char*     key;
+long            default_value;
+long            candidates[TUNE_MAX_CANDIDATES];  // 0 terminated.  Empty --> thread counts
+struct command  commands[TUNE_MAX_COMMANDS];      // the workload, NULL program terminated
+long            chosen;
+};
+
+// The semiprimes for factor are balanced, so each tier's share of the work
+// shows:  small factors for trial division, 9 to 12 digit ones for rho, and
+// 30 to 38 digit numbers either side of the ECM / SIQS crossover.
+struct tunable tunables[] = {
+  { "factor_range.segment_size", 32768, { 4096, 8192, 16384, 32768, 65536, 131072, 262144 },
+    { { { "factor_range", "-t", "1", "1000000000000", "1000002000000" } } } },
+  { "factor_range.threads", 0, { 0 },
+    { { { "factor_range", "1000000000000", "1000008000000" } } } },
+  { "coord.segment_size", 262144, { 32768, 65536, 131072, 262144, 524288, 1048576 },
+    { { { "coord", "worker", TUNE_JOB_DIR }, 1 } } },
+  { "factor.tf_limit", 65536, { 4096, 16384, 65536, 262144, 1048576 },
+    { { { "factor", "-t", "1", "304415408256839090545954909000425089" } },
+      { { "factor", "-t", "1", "33507904796401731568627470516599" } },
+      { { "factor", "-t", "1", "82709370456964352111800581446154473060567719" } },
+      { { "factor", "-t", "1", "1000000016000000063" } } } },
+  { "factor.rho_iterations", 20000, { 1, 5000, 20000, 80000, 320000 },
+    { { { "factor", "-t", "1", "69120332676587481390220185890957888947" } },
+      { { "factor", "-t", "1", "259835094135069208456976172095135589233" } },
+      { { "factor", "-t", "1", "329745103783087528615295963106220745897347" } } } },
+  { "factor.siqs_min_bits", 130, { 90, 100, 110, 120, 130 },
+    { { { "factor", "-t", "1", "84055899507848841139275608657" } },
+      { { "factor", "-t", "1", "15517103910503274975300864679559" } },
+      { { "factor", "-t", "1", "3848012627453569853248023696792827" } },
+      { { "factor", "-t", "1", "115894446811470612144213492667304891" } },
+      { { "factor", "-t", "1", "33629854413209577829738663679510322317" } } } },
+};
+
+#define TUNABLE_COUNT ((int) (sizeof(tunables) / sizeof(tunables[0])))
+
+int Thread_Candidates( long*, int );
+int Write_Profile( const char*, int, int );
+double Time_Workload( const char*, struct tunable*, int );
+int Run_Once( const char*, const struct command*, int, double* );
+int Coord_Init( const char* );
+void Remove_Coord_Job( void );
+
+char scratch_profile[64];
+
+int main( int argc, char * argv[] ) {
+
+  const char* bindir = ".";
+  const char* filter = NULL;
+  const char* out_path = Profile_File();
+  int runs = 3;
+  int dry_run = 0;
+
+  int argi = 1;
+  for ( ; argi < argc; argi++ ) {
+    if ( !strcmp( argv[argi], "-n" ) )
+      dry_run = 1;
+    else if ( argi + 1 >= argc )
+      break;
+    else if ( !strcmp( argv[argi], "-d" ) )
+      bindir = argv[++argi];
+    else if ( !strcmp( argv[argi], "-f" ) )
+      filter = argv[++argi];
+    else if ( !strcmp( argv[argi], "-o" ) )
+      out_path = argv[++argi];
+    else if ( !strcmp( argv[argi], "-r" ) )
+      runs = atoi( argv[++argi] );
+    else
+      break;
+  }
+
+  if ( argi != argc || runs < 1 || out_path[0] == '\0' ) {
+    printf( "\nUsage: tune [-d bindir] [-f filter] [-r runs] [-o profile] [-n]\n\n" );
+    printf( "  -f   only tune settings whose name contains filter.  The others keep their current values\n" );
+    printf( "  -r   runs per candidate, the fastest counts (default 3)\n" );
+    printf( "  -o   where to write the profile (default $FACTORING_PROFILE or ~/.factoring_profile)\n" );
+    printf( "  -n   only print the results\n\n" );
+    return 1;
+  }
+
+  snprintf( scratch_profile, sizeof(scratch_profile), "/tmp/tune_profile.%d", (int) getpid() );
+  setenv( "FACTORING_PROFILE", scratch_profile, 1 );
+
+  int cpus = (int) sysconf( _SC_NPROCESSORS_ONLN );
+  int t, c;
+  for ( t = 0; t < TUNABLE_COUNT; t++ ) {
+    struct tunable* tunable = &tunables[t];
+    if ( tunable->candidates[0] == 0 ) {
+      tunable->default_value = cpus;
+      Thread_Candidates( tunable->candidates, cpus );
+    }
+    // settings not tuned this time keep what the profile has now
+    tunable->chosen = Profile_Get( tunable->key, tunable->default_value );
+  }
+
+  printf( "\n%-28s %10s %12s\n", "setting", "value", "time (s)" );
+
+  int failed = 0;
+  for ( t = 0; t < TUNABLE_COUNT; t++ ) {
+    struct tunable* tunable = &tunables[t];
+    if ( filter != NULL && strstr( tunable->key, filter ) == NULL )
+      continue;
+
+    double default_secs = -1.0, best_secs = -1.0;
+    long best = tunable->default_value;
+    for ( c = 0; c < TUNE_MAX_CANDIDATES && tunable->candidates[c] != 0; c++ ) {
+      tunable->chosen = tunable->candidates[c];
+      if ( !Write_Profile( scratch_profile, TUNABLE_COUNT, 0 ) ) {
+        fprintf( stderr, "Error: Cannot write %s. Aborting.\n\n", scratch_profile );
+        return 1;
+      }
+
+      double secs = Time_Workload( bindir, tunable, runs );
+      if ( secs < 0 ) {
+        printf( "%-28s %10ld %12s\n", tunable->key, tunable->candidates[c], "FAILED" );
+        failed = 1;
+        continue;
+      }
+      printf( "%-28s %10ld %12.6f\n", tunable->key, tunable->candidates[c], secs );
+      fflush( stdout );
+
+      if ( tunable->candidates[c] == tunable->default_value )
+        default_secs = secs;
+      if ( best_secs < 0 || secs < best_secs ) {
+        best_secs = secs;
+        best = tunable->candidates[c];
+      }
+    }
+
+    // a small win is not worth moving off the default for
+    if ( default_secs >= 0 && best_secs >= default_secs * (1.0 - TUNE_MIN_GAIN) )
+      best = tunable->default_value;
+    tunable->chosen = best;
+    printf( "%-28s %10ld   <-- chosen\n\n", tunable->key, best );
+  }
+
+  unlink( scratch_profile );
+
+  if ( failed )
+    fprintf( stderr, "Some runs failed.  Are the programs built (make) and in %s?\n\n", bindir );
+
+  if ( dry_run )
+    return failed;
+
+  if ( !Write_Profile( out_path, TUNABLE_COUNT, 1 ) ) {
+    fprintf( stderr, "Error: Cannot write %s. Aborting.\n\n", out_path );
+    return 1;
+  }
+  printf( "Profile written to %s\n\n", out_path );
+
+  return failed;
+}
+
+// 1, 2, 4, ... below the cpus, the cpus, and twice that (for SMT)
+int Thread_Candidates( long* candidates, int cpus ) {
+  int count = 0;
+  long threads;
+  for ( threads = 1; threads < cpus && count < TUNE_MAX_CANDIDATES - 3; threads *= 2 )
+    candidates[count++] = threads;
+  candidates[count++] = cpus;
+  candidates[count++] = 2 * cpus;
+  candidates[count] = 0;
+  return count;
+}
+
+// Every setting at its chosen value
+int Write_Profile( const char* path, int count, int with_header ) {
+  FILE* f = fopen( path, "w" );
+  if ( f == NULL )
+    return 0;
+
+  if ( with_header ) {
+    char host[256];
+    time_t now = time( NULL );
+    if ( gethostname( host, sizeof(host) ) != 0 )
+      strcpy( host, "unknown" );
+    host[sizeof(host) - 1] = '\0';
+    fprintf( f, "# Machine profile written by tune on %s, %ld cpus, %s", host,
+             sysconf( _SC_NPROCESSORS_ONLN ), ctime( &now ) );
+  }
+
+  int t;
+  for ( t = 0; t < count; t++ )
+    fprintf( f, "%s=%ld\n", tunables[t].key, tunables[t].chosen );
+
+  return fclose( f ) == 0;
+}
+
+// Fastest of runs, summed over the commands.  -1 if any run failed.
+double Time_Workload( const char* bindir, struct tunable* tunable, int runs ) {
+  double total = 0;
+  int c, r;
+  for ( c = 0; c < TUNE_MAX_COMMANDS && tunable->commands[c].args[0] != NULL; c++ ) {
+    double best = -1.0;
+    for ( r = 0; r < runs; r++ ) {
+      double secs;
+      if ( !Run_Once( bindir, &tunable->commands[c], 1, &secs ) )
+        return -1.0;
+      if ( best < 0 || secs < best )
+        best = secs;
+    }
+    total += best;
+  }
+  return total;
+}
+
+// One run, output to /dev/null.  Returns 1 with the wall time if the program
+// exited with status 0.
+int Run_Once( const char* bindir, const struct command* command, int timed, double* secs ) {
+  char path[4096];
+  snprintf( path, sizeof(path), "%s/%s", bindir, command->args[0] );
+
+  if ( command->coord_job && !Coord_Init( bindir ) )
+    return 0;
+
+  struct timespec time_t0, time_t1;
+  clock_gettime( CLOCK_MONOTONIC, &time_t0 );
+
+  pid_t pid = fork();
+  if ( pid < 0 )
+    return 0;
+
+  if ( pid == 0 ) {
+    int devnull = open( "/dev/null", O_WRONLY );
+    if ( devnull >= 0 ) {
+      dup2( devnull, STDOUT_FILENO );
+      close( devnull );
+    }
+    execv( path, (char * const *) command->args );
+    fprintf( stderr, "Error: Cannot run %s.\n", path );
+    _exit( 127 );
+  }
+
+  int status = 0;
+  if ( waitpid( pid, &status, 0 ) != pid )
+    return 0;
+
+  clock_gettime( CLOCK_MONOTONIC, &time_t1 );
+  if ( timed )
+    *secs = (time_t1.tv_sec - time_t0.tv_sec) + (time_t1.tv_nsec - time_t0.tv_nsec) / 1e9;
+
+  if ( command->coord_job )
+    Remove_Coord_Job();
+
+  return WIFEXITED( status ) && WEXITSTATUS( status ) == 0;
+}
+
+// A fresh one unit count job for coord:  the primes below 3 x 10^8
+int Coord_Init( const char* bindir ) {
+  Remove_Coord_Job();
+  const struct command init = { { "coord", "init", TUNE_JOB_DIR, "count", "1", "300000000", "300000000" }, 0 };
+  double unused;
+  return Run_Once( bindir, &init, 0, &unused );
+}
+
+// What a finished coord job leaves behind, with the worker's result still
+// in done/ as no coordinator collected it
+void Remove_Coord_Job( void ) {
+  const char* files[2] = { "job", "journal" };
+  const char* dirs[3] = { "todo", "claimed", "done" };
+  char path[4096];
+  int i;
+  for ( i = 0; i < 2; i++ ) {
+    snprintf( path, sizeof(path), "%s/%s", TUNE_JOB_DIR, files[i] );
+    unlink( path );
+  }
+  for ( i = 0; i < 3; i++ ) {
+    snprintf( path, sizeof(path), "%s/%s", TUNE_JOB_DIR, dirs[i] );
+    DIR* d = opendir( path );
+    if ( d != NULL ) {
+      struct dirent* entry;
+      while ( (entry = readdir( d )) != NULL ) {
+        char file[4096 + 256];
+        if ( entry->d_name[0] == '.' )
+          continue;
+        snprintf( file, sizeof(file), "%s/%s", path, entry->d_name );
+        unlink( file );
+      }
+      closedir( d );
+    }
+    rmdir( path );
+  }
+  rmdir( TUNE_JOB_DIR );
+}